@@ -333,6 +333,23 @@ CPPFLAGS      = -mmcu=$(MCU) -DF_CPU=$(F_CPU) -DARDUINO=$(ARDUINO_VERSION) \
 			-I. -I$(ARDUINO_CORE_PATH) -I$(ARDUINO_VAR_PATH)/$(VARIANT) \
 			$(SYS_INCLUDES) $(USER_INCLUDES) -g -Os -w -Wall \
 			-ffunction-sections -fdata-sections
+# PROFILE = 1 in the sketch's Makefile compiles in the PROFILE_SCOPE()
+# probes (see wiring_profile.h); tools/profile.py reads their dump.
+# make clean after changing it, since the objects don't depend on it
+ifdef PROFILE
+CPPFLAGS     += -DPROFILE
+endif
+# ISR_ACCOUNTING = 1 likewise times the interrupt handlers and the
+# sections with interrupts off (see wiring_isr.h)
+ifdef ISR_ACCOUNTING
+CPPFLAGS     += -DISR_ACCOUNTING
+endif
+# TONE_TIMERS = 1 3 lets tone() use timers 1 and 3 as well as 2, at
+# the cost of their compare A interrupts, which Servo also wants
+ifdef TONE_TIMERS
+CPPFLAGS     += $(patsubst %,-DTONE_USE_TIMER%,$(TONE_TIMERS))
+endif
+
 CFLAGS        = -std=gnu99
 CXXFLAGS      = -fno-exceptions
 ASFLAGS       = -mmcu=$(MCU) -I. -x assembler-with-cpp 
@@ -0,0 +1,47 @@
+/*
+ AnalogStream.cpp - binary output for the ADC stream
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "wiring.h"
+#include "wiring_adc.h"
+
+#include "Print.h"
+
+// Sends up to len buffered stream samples to out, typically a
+// HardwareSerial, and returns how many went.  Each 10-bit sample takes two
+// bytes: the first has the top bit set and carries bits 9-7, the second
+// has the top bit clear and carries bits 6-0.  A receiver can pick up the
+// stream anywhere by waiting for a byte with the top bit set.  At 10
+// bits a byte on the wire, n samples per second need 20 * n baud.
+unsigned int analogStreamWrite(Print &out, unsigned int len)
+{
+  int buf[8];
+  unsigned int sent = 0;
+
+  while (sent < len) {
+    unsigned int n = analogStreamRead(buf, len - sent < 8 ? len - sent : 8);
+    if (n == 0)
+      break;
+    for (unsigned int i = 0; i < n; i++) {
+      out.write((uint8_t) (0x80 | (buf[i] >> 7)));
+      out.write((uint8_t) (buf[i] & 0x7F));
+    }
+    sent += n;
+  }
+
+  return sent;
+}
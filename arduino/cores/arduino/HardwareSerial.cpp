@@ -80,6 +80,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
 #if defined(USART_RX_vect)
   SIGNAL(USART_RX_vect)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL0);
+
   #if defined(UDR0)
     unsigned char c  =  UDR0;
   #elif defined(UDR)
@@ -92,12 +94,16 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
 #elif defined(SIG_USART0_RECV) && defined(UDR0)
   SIGNAL(SIG_USART0_RECV)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL0);
+
     unsigned char c  =  UDR0;
     store_char(c, &rx_buffer);
   }
 #elif defined(SIG_UART0_RECV) && defined(UDR0)
   SIGNAL(SIG_UART0_RECV)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL0);
+
     unsigned char c  =  UDR0;
     store_char(c, &rx_buffer);
   }
@@ -107,6 +113,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
   //SIGNAL(SIG_USART_RECV)
   SIGNAL(USART0_RX_vect)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL0);
+
   #if defined(UDR0)
     unsigned char c  =  UDR0;
   #elif defined(UDR)
@@ -120,6 +128,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
   // this is for atmega8
   SIGNAL(SIG_UART_RECV)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL0);
+
   #if defined(UDR0)
     unsigned char c  =  UDR0;  //  atmega645
   #elif defined(UDR)
@@ -139,6 +149,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
   //SIGNAL(SIG_USART1_RECV)
   SIGNAL(USART1_RX_vect)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL1);
+
     unsigned char c = UDR1;
     store_char(c, &rx_buffer1);
   }
@@ -149,6 +161,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
 #if defined(USART2_RX_vect) && defined(UDR2)
   SIGNAL(USART2_RX_vect)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL2);
+
     unsigned char c = UDR2;
     store_char(c, &rx_buffer2);
   }
@@ -159,6 +173,8 @@ inline void store_char(unsigned char c, ring_buffer *rx_buffer)
 #if defined(USART3_RX_vect) && defined(UDR3)
   SIGNAL(USART3_RX_vect)
   {
+    ISR_ACCOUNT(ISR_ID_SERIAL3);
+
     unsigned char c = UDR3;
     store_char(c, &rx_buffer3);
   }
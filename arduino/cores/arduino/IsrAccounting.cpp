@@ -0,0 +1,90 @@
+/*
+ IsrAccounting.cpp - dumping the interrupt time accounting
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "wiring.h"
+#include "wiring_isr.h"
+
+#include "Print.h"
+
+#if defined(ISR_ACCOUNTING)
+
+static void printSlot(Print &out, uint8_t id)
+{
+  if (id == ISR_ID_TIMER0_OVF) {
+    out.print("timer0_ovf");
+  } else if (id < ISR_ID_INT0) {
+    out.print("serial");
+    out.print(id - ISR_ID_SERIAL0);
+  } else if (id < ISR_ID_USER) {
+    out.print("int");
+    out.print(id - ISR_ID_INT0);
+  } else {
+    out.print("user");
+    out.print(id - ISR_ID_USER);
+  }
+}
+
+// Sends the accounting to out, typically a HardwareSerial, as text:
+//
+//   isr <F_CPU>
+//   <slot> <count> <cycles> <max>
+//   ...
+//   critical <max> <file:line>
+//   latency <max>
+//   end
+//
+// with the times in cycles and only the slots that have run listed.  The
+// slots are named timer0_ovf, serial0-3, int0-7 (by attachInterrupt()
+// number) and user0 on.
+void isrDump(Print &out)
+{
+  isr_stat s;
+  PGM_P where = isrCriticalWhere();
+
+  out.print("isr ");
+  out.println((unsigned long) F_CPU);
+
+  for (uint8_t id = 0; isrRead(id, &s); id++) {
+    if (s.count == 0)
+      continue;
+    printSlot(out, id);
+    out.print(' ');
+    out.print(s.count);
+    out.print(' ');
+    out.print(s.cycles);
+    out.print(' ');
+    out.println(s.max);
+  }
+
+  out.print("critical ");
+  out.print(isrCriticalMax());
+  out.print(' ');
+  if (where) {
+    for (char c; (c = pgm_read_byte(where)) != 0; where++)
+      out.write((uint8_t) c);
+  } else {
+    out.print('-');
+  }
+  out.println();
+
+  out.print("latency ");
+  out.println(isrLatencyMax());
+  out.println("end");
+}
+
+#endif
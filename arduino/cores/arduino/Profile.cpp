@@ -0,0 +1,110 @@
+/*
+ Profile.cpp - dumping the profiling probes
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "wiring.h"
+#include "wiring_profile.h"
+
+#include "Print.h"
+
+#if defined(PROFILE)
+
+static void writeLong(Print &out, unsigned long v, uint8_t *sum)
+{
+  for (uint8_t i = 0; i < 4; i++) {
+    out.write((uint8_t) v);
+    *sum += (uint8_t) v;
+    v >>= 8;
+  }
+}
+
+// Sends every probe to out, typically a HardwareSerial, for
+// tools/profile.py to pretty-print.  PROFILE_TEXT is readable as it is:
+//
+//   profile <F_CPU> <overhead>
+//   <name> <count> <total> <min> <max>
+//   ...
+//   end
+//
+// with the times in cycles and min 0 for a probe that hasn't run.
+// PROFILE_BINARY takes about a third of the bytes: 0xA5 'P', the number
+// of probes, F_CPU and the overhead, then for each probe the length of
+// its name, the name and count, total, min and max, and last a checksum,
+// the sum of every byte after 'P'.  Numbers are 4 bytes, low byte first.
+void profileDump(Print &out, uint8_t format)
+{
+  profile_probe p;
+  uint8_t n = 0;
+  uint8_t sum = 0;
+
+  while (profileRead(n, &p))
+    n++;
+
+  if (format == PROFILE_BINARY) {
+    out.write((uint8_t) 0xA5);
+    out.write((uint8_t) 'P');
+    out.write(n);
+    sum = n;
+    writeLong(out, F_CPU, &sum);
+    writeLong(out, profileOverhead(), &sum);
+  } else {
+    out.print("profile ");
+    out.print((unsigned long) F_CPU);
+    out.print(' ');
+    out.println(profileOverhead());
+  }
+
+  // a probe that first runs after the count waits for the next dump
+  for (uint8_t i = 0; i < n && profileRead(i, &p); i++) {
+    uint8_t len = strlen_P(p.name);
+
+    if (p.count == 0)
+      p.min = 0;
+
+    if (format == PROFILE_BINARY) {
+      out.write(len);
+      sum += len;
+      for (uint8_t j = 0; j < len; j++) {
+        uint8_t c = pgm_read_byte(p.name + j);
+        out.write(c);
+        sum += c;
+      }
+      writeLong(out, p.count, &sum);
+      writeLong(out, p.total, &sum);
+      writeLong(out, p.min, &sum);
+      writeLong(out, p.max, &sum);
+    } else {
+      for (uint8_t j = 0; j < len; j++)
+        out.write((uint8_t) pgm_read_byte(p.name + j));
+      out.print(' ');
+      out.print(p.count);
+      out.print(' ');
+      out.print(p.total);
+      out.print(' ');
+      out.print(p.min);
+      out.print(' ');
+      out.println(p.max);
+    }
+  }
+
+  if (format == PROFILE_BINARY)
+    out.write(sum);
+  else
+    out.println("end");
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ Sampler.cpp - dumping the sampling profiler
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "wiring.h"
+#include "wiring_profile.h"
+
+#include "Print.h"
+
+#if defined(TIMSK0) && defined(OCIE0A)
+
+// Sends the sampler's histogram to out, typically a HardwareSerial, as
+// text for tools/sampler.py:
+//
+//   sampler <samples per second> <base> <bin size> <bins> <outside>
+//   <bin> <count>
+//   ...
+//   end
+//
+// with the base address and bin size in bytes, and only the bins that
+// have counts listed.
+void samplerDump(Print &out)
+{
+  out.print("sampler ");
+  out.print((unsigned long) F_CPU / 16384);
+  out.print(' ');
+  out.print(samplerBase());
+  out.print(' ');
+  out.print(samplerBinSize());
+  out.print(' ');
+  out.print((unsigned int) SAMPLER_BINS);
+  out.print(' ');
+  out.println(samplerCount(SAMPLER_BINS));
+
+  for (unsigned int i = 0; i < SAMPLER_BINS; i++) {
+    unsigned int n = samplerCount(i);
+    if (n == 0)
+      continue;
+    out.print(i);
+    out.print(' ');
+    out.println(n);
+  }
+
+  out.println("end");
+}
+
+#endif
@@ -29,11 +29,14 @@ Version Modified By Date     Comments
                     09/11/25 Fixed timer0 from being excluded
 0006    D Mellis    09/12/29 Replaced objects with functions
 0007    M Sproul    10/08/29 Changed #ifdefs from cpu to register
+0008                         Timers taken with timerAcquire(); one tone per
+                             free timer, restoring pwm afterwards; timers
+                             1 and 3-5 only with TONE_USE_TIMERn
 *************************************************/
 
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
-#include "wiring.h"
+#include "wiring_private.h"
 #include "pins_arduino.h"
 
 #if defined(__AVR_ATmega8__) || defined(__AVR_ATmega128__)
@@ -85,30 +88,70 @@ volatile uint8_t timer5_pin_mask;
 #endif
 
 
-// MLS: This does not make sense, the 3 options are the same
-#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-
-#define AVAILABLE_TONE_PINS 1
-
-const uint8_t PROGMEM tone_pin_to_timer_PGM[] = { 2 /*, 3, 4, 5, 1, 0 */ };
-static uint8_t tone_pins[AVAILABLE_TONE_PINS] = { 255 /*, 255, 255, 255, 255, 255 */ };
-
-#elif defined(__AVR_ATmega8__)
-
-#define AVAILABLE_TONE_PINS 1
-
-const uint8_t PROGMEM tone_pin_to_timer_PGM[] = { 2 /*, 1 */ };
-static uint8_t tone_pins[AVAILABLE_TONE_PINS] = { 255 /*, 255 */ };
-
+// Each tone needs a timer of its own, taken with timerAcquire() and given
+// back to pwm when the tone ends, so there can be as many tones at once as
+// there are timers nobody else is using.  Timer 0 is never used, since
+// millis() runs on it.  A tone for which no timer can be had isn't played.
+//
+// Timer 2 is always there for tone().  Timers 1 and 3-5 are what the
+// Servo library runs on, and a sketch can only have one handler for an
+// interrupt, so their compare A handlers here are built only when asked
+// for: TONE_USE_TIMER1, TONE_USE_TIMER3 and so on (TONE_TIMERS in
+// Arduino.mk).
+#if defined(TONE_USE_TIMER1) && !defined(__AVR_ATmega8__)
+#define TONE_TIMER1 1
+#else
+#define TONE_TIMER1 0
+#endif
+#if defined(TONE_USE_TIMER3) && defined(TIMSK3)
+#define TONE_TIMER3 1
+#else
+#define TONE_TIMER3 0
+#endif
+#if defined(TONE_USE_TIMER4) && defined(TIMSK4)
+#define TONE_TIMER4 1
+#else
+#define TONE_TIMER4 0
+#endif
+#if defined(TONE_USE_TIMER5) && defined(TIMSK5)
+#define TONE_TIMER5 1
 #else
+#define TONE_TIMER5 0
+#endif
 
-#define AVAILABLE_TONE_PINS 1
+#define AVAILABLE_TONE_PINS (1 + TONE_TIMER3 + TONE_TIMER4 + TONE_TIMER5 + TONE_TIMER1)
 
-// Leave timer 0 to last.
-const uint8_t PROGMEM tone_pin_to_timer_PGM[] = { 2 /*, 1, 0 */ };
-static uint8_t tone_pins[AVAILABLE_TONE_PINS] = { 255 /*, 255, 255 */ };
+const uint8_t PROGMEM tone_pin_to_timer_PGM[] = {
+  2,
+#if TONE_TIMER3
+  3,
+#endif
+#if TONE_TIMER4
+  4,
+#endif
+#if TONE_TIMER5
+  5,
+#endif
+#if TONE_TIMER1
+  1,
+#endif
+};
 
+static uint8_t tone_pins[AVAILABLE_TONE_PINS] = {
+  255,
+#if TONE_TIMER3
+  255,
+#endif
+#if TONE_TIMER4
+  255,
 #endif
+#if TONE_TIMER5
+  255,
+#endif
+#if TONE_TIMER1
+  255,
+#endif
+};
 
 
 
@@ -125,7 +168,8 @@ static int8_t toneBegin(uint8_t _pin)
   
   // search for an unused timer.
   for (int i = 0; i < AVAILABLE_TONE_PINS; i++) {
-    if (tone_pins[i] == 255) {
+    if (tone_pins[i] == 255 &&
+        timerAcquire(pgm_read_byte(tone_pin_to_timer_PGM + i), TIMER_OWNER_TONE)) {
       tone_pins[i] = _pin;
       _timer = pgm_read_byte(tone_pin_to_timer_PGM + i);
       break;
@@ -407,9 +451,8 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
 }
 
 
-// XXX: this function only works properly for timer 2 (the only one we use
-// currently).  for the others, it should end the tone, but won't restore
-// proper PWM functionality for the timer.
+// ends the tone and puts the timer back the way init() left it: prescale
+// factor 64, 8-bit phase correct pwm.
 void disableTimer(uint8_t _timer)
 {
   switch (_timer)
@@ -425,6 +468,9 @@ void disableTimer(uint8_t _timer)
 #if defined(TIMSK1) && defined(OCIE1A)
     case 1:
       bitWrite(TIMSK1, OCIE1A, 0);
+      TCCR1B = (1 << CS11) | (1 << CS10);
+      TCCR1A = (1 << WGM10);
+      pwm_top[1] = 255;
       break;
 #endif
 
@@ -445,19 +491,28 @@ void disableTimer(uint8_t _timer)
 
 #if defined(TIMSK3)
     case 3:
-      TIMSK3 = 0;
+      bitWrite(TIMSK3, OCIE3A, 0);
+      TCCR3B = (1 << CS31) | (1 << CS30);
+      TCCR3A = (1 << WGM30);
+      pwm_top[3] = 255;
       break;
 #endif
 
 #if defined(TIMSK4)
     case 4:
-      TIMSK4 = 0;
+      bitWrite(TIMSK4, OCIE4A, 0);
+      TCCR4B = (1 << CS41) | (1 << CS40);
+      TCCR4A = (1 << WGM40);
+      pwm_top[4] = 255;
       break;
 #endif
 
 #if defined(TIMSK5)
     case 5:
-      TIMSK5 = 0;
+      bitWrite(TIMSK5, OCIE5A, 0);
+      TCCR5B = (1 << CS51) | (1 << CS50);
+      TCCR5A = (1 << WGM50);
+      pwm_top[5] = 255;
       break;
 #endif
   }
@@ -476,10 +531,13 @@ void noTone(uint8_t _pin)
   }
   
   disableTimer(_timer);
+  if (_timer >= 0)
+    timerRelease(_timer, TIMER_OWNER_TONE);
 
   digitalWrite(_pin, 0);
 }
 
+// timer 0 runs millis(), so it never plays a tone
 #if 0
 #if !defined(__AVR_ATmega8__)
 ISR(TIMER0_COMPA_vect)
@@ -499,8 +557,24 @@ ISR(TIMER0_COMPA_vect)
   }
 }
 #endif
+#endif
+
+
+// called from a timer's interrupt when its tone is over.  we need to call
+// noTone() so that the tone_pins[] entry is reset and the timer released,
+// so the timer gets initialized next time we call tone().
+static void toneEnd(uint8_t _timer)
+{
+  for (int i = 0; i < AVAILABLE_TONE_PINS; i++) {
+    if (pgm_read_byte(tone_pin_to_timer_PGM + i) == _timer && tone_pins[i] != 255) {
+      noTone(tone_pins[i]);
+      return;
+    }
+  }
+}
 
 
+#if TONE_TIMER1
 ISR(TIMER1_COMPA_vect)
 {
   if (timer1_toggle_count != 0)
@@ -513,8 +587,7 @@ ISR(TIMER1_COMPA_vect)
   }
   else
   {
-    disableTimer(1);
-    *timer1_pin_port &= ~(timer1_pin_mask);  // keep pin low after stop
+    toneEnd(1);
   }
 }
 #endif
@@ -522,7 +595,6 @@ ISR(TIMER1_COMPA_vect)
 
 ISR(TIMER2_COMPA_vect)
 {
-
   if (timer2_toggle_count != 0)
   {
     // toggle the pin
@@ -533,20 +605,12 @@ ISR(TIMER2_COMPA_vect)
   }
   else
   {
-    // need to call noTone() so that the tone_pins[] entry is reset, so the
-    // timer gets initialized next time we call tone().
-    // XXX: this assumes timer 2 is always the first one used.
-    noTone(tone_pins[0]);
-//    disableTimer(2);
-//    *timer2_pin_port &= ~(timer2_pin_mask);  // keep pin low after stop
+    toneEnd(2);
   }
 }
 
 
-
-//#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-#if 0
-
+#if TONE_TIMER3
 ISR(TIMER3_COMPA_vect)
 {
   if (timer3_toggle_count != 0)
@@ -559,11 +623,12 @@ ISR(TIMER3_COMPA_vect)
   }
   else
   {
-    disableTimer(3);
-    *timer3_pin_port &= ~(timer3_pin_mask);  // keep pin low after stop
+    toneEnd(3);
   }
 }
+#endif
 
+#if TONE_TIMER4
 ISR(TIMER4_COMPA_vect)
 {
   if (timer4_toggle_count != 0)
@@ -576,11 +641,12 @@ ISR(TIMER4_COMPA_vect)
   }
   else
   {
-    disableTimer(4);
-    *timer4_pin_port &= ~(timer4_pin_mask);  // keep pin low after stop
+    toneEnd(4);
   }
 }
+#endif
 
+#if TONE_TIMER5
 ISR(TIMER5_COMPA_vect)
 {
   if (timer5_toggle_count != 0)
@@ -593,9 +659,7 @@ ISR(TIMER5_COMPA_vect)
   }
   else
   {
-    disableTimer(5);
-    *timer5_pin_port &= ~(timer5_pin_mask);  // keep pin low after stop
+    toneEnd(5);
   }
 }
-
 #endif
@@ -0,0 +1,45 @@
+/*
+  WInterruptsAll.c - attachInterrupt() on a number known only at run time
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+
+// Refers to every interrupt number's handler, so it's only linked for an
+// attachInterrupt() or detachInterrupt() whose number the compiler
+// couldn't see; the handlers can't then be mixed with
+// EXTERNAL_INTERRUPT_HANDLER().
+volatile external_interrupt *externalInterruptSlot(uint8_t interruptNum)
+{
+	switch (interruptNum) {
+	case 0: return &external_interrupt_0;
+	case 1: return &external_interrupt_1;
+#if defined(EICRA) && defined(EICRB)
+	case 2: return &external_interrupt_2;
+	case 3: return &external_interrupt_3;
+	case 4: return &external_interrupt_4;
+	case 5: return &external_interrupt_5;
+	case 6: return &external_interrupt_6;
+	case 7: return &external_interrupt_7;
+#endif
+	}
+	return 0;
+}
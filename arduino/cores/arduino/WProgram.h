@@ -8,6 +8,14 @@
 #include <avr/interrupt.h>
 
 #include "wiring.h"
+#include "wiring_spi.h"
+#include "wiring_twi.h"
+#include "wiring_adc.h"
+#include "wiring_coroutine.h"
+#include "wiring_synth.h"
+#include "wiring_profile.h"
+#include "wiring_isr.h"
+#include "wiring_memory.h"
 
 #ifdef __cplusplus
 #include "WCharacter.h"
@@ -21,6 +29,11 @@ uint16_t makeWord(byte h, byte l);
 
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
 
+inline void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, unsigned int len)
+  { shiftOutBuffer(dataPin, clockPin, bitOrder, buf, len); }
+inline void shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buf, unsigned int len)
+  { shiftInBuffer(dataPin, clockPin, bitOrder, buf, len); }
+
 void tone(uint8_t _pin, unsigned int frequency, unsigned long duration = 0);
 void noTone(uint8_t _pin);
 
@@ -88,7 +88,7 @@ String::String( const long value, const int base )
 String::String( const unsigned long value, const int base )
 {
   char buf[33];   
-  ultoa(value, buf, 10);
+  ultoa(value, buf, base);
   getBuffer( _length = strlen(buf) );
   if ( _buffer != NULL )
     strcpy( _buffer, buf );
@@ -1,13 +1,28 @@
 #include <WProgram.h>
 
+// only there if the sketch uses the software timers, tasks or coroutines
+extern "C" void softTimerRun(void) __attribute__ ((weak));
+extern "C" uint8_t taskRun(void) __attribute__ ((weak));
+extern "C" uint8_t coroutineRun(void) __attribute__ ((weak));
+extern "C" void memoryWatchRun(void) __attribute__ ((weak));
+
 int main(void)
 {
 	init();
 
 	setup();
     
-	for (;;)
-		loop();
+	for (;;) {
+		if (!taskRun || !taskRun())
+			loop();
+		if (coroutineRun)
+			coroutineRun();
+		if (softTimerRun)
+			softTimerRun();
+		if (memoryWatchRun)
+			memoryWatchRun();
+		idle();
+	}
         
 	return 0;
 }
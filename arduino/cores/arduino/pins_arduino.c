@@ -81,50 +81,50 @@
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
 const uint16_t PROGMEM port_to_mode_PGM[] = {
 	NOT_A_PORT,
-	&DDRA,
-	&DDRB,
-	&DDRC,
-	&DDRD,
-	&DDRE,
-	&DDRF,
-	&DDRG,
-	&DDRH,
+	pinsAddress(DDRA),
+	pinsAddress(DDRB),
+	pinsAddress(DDRC),
+	pinsAddress(DDRD),
+	pinsAddress(DDRE),
+	pinsAddress(DDRF),
+	pinsAddress(DDRG),
+	pinsAddress(DDRH),
 	NOT_A_PORT,
-	&DDRJ,
-	&DDRK,
-	&DDRL,
+	pinsAddress(DDRJ),
+	pinsAddress(DDRK),
+	pinsAddress(DDRL),
 };
 
 const uint16_t PROGMEM port_to_output_PGM[] = {
 	NOT_A_PORT,
-	&PORTA,
-	&PORTB,
-	&PORTC,
-	&PORTD,
-	&PORTE,
-	&PORTF,
-	&PORTG,
-	&PORTH,
+	pinsAddress(PORTA),
+	pinsAddress(PORTB),
+	pinsAddress(PORTC),
+	pinsAddress(PORTD),
+	pinsAddress(PORTE),
+	pinsAddress(PORTF),
+	pinsAddress(PORTG),
+	pinsAddress(PORTH),
 	NOT_A_PORT,
-	&PORTJ,
-	&PORTK,
-	&PORTL,
+	pinsAddress(PORTJ),
+	pinsAddress(PORTK),
+	pinsAddress(PORTL),
 };
 
 const uint16_t PROGMEM port_to_input_PGM[] = {
 	NOT_A_PIN,
-	&PINA,
-	&PINB,
-	&PINC,
-	&PIND,
-	&PINE,
-	&PINF,
-	&PING,
-	&PINH,
+	pinsAddress(PINA),
+	pinsAddress(PINB),
+	pinsAddress(PINC),
+	pinsAddress(PIND),
+	pinsAddress(PINE),
+	pinsAddress(PINF),
+	pinsAddress(PING),
+	pinsAddress(PINH),
 	NOT_A_PIN,
-	&PINJ,
-	&PINK,
-	&PINL,
+	pinsAddress(PINJ),
+	pinsAddress(PINK),
+	pinsAddress(PINL),
 };
 
 const uint8_t PROGMEM digital_pin_to_port_PGM[] = {
@@ -351,6 +351,17 @@ const uint8_t PROGMEM digital_pin_to_timer_PGM[] = {
 	NOT_ON_TIMER	, // PK 6 ** 68 ** A14	
 	NOT_ON_TIMER	, // PK 7 ** 69 ** A15	
 };
+
+const uint8_t PROGMEM interrupt_to_digital_pin_PGM[] = {
+	2	, // INT4 ** 0 ** PE 4	
+	3	, // INT5 ** 1 ** PE 5	
+	21	, // INT0 ** 2 ** PD 0	
+	20	, // INT1 ** 3 ** PD 1	
+	19	, // INT2 ** 4 ** PD 2	
+	18	, // INT3 ** 5 ** PD 3	
+	NOT_A_PIN	, // INT6 ** 6 ** PE 6 (not brought out)	
+	NOT_A_PIN	, // INT7 ** 7 ** PE 7 (not brought out)	
+};
 #else
 // these arrays map port names (e.g. port B) to the
 // appropriate addresses for various functions (e.g. reading
@@ -358,25 +369,25 @@ const uint8_t PROGMEM digital_pin_to_timer_PGM[] = {
 const uint16_t PROGMEM port_to_mode_PGM[] = {
 	NOT_A_PORT,
 	NOT_A_PORT,
-	&DDRB,
-	&DDRC,
-	&DDRD,
+	pinsAddress(DDRB),
+	pinsAddress(DDRC),
+	pinsAddress(DDRD),
 };
 
 const uint16_t PROGMEM port_to_output_PGM[] = {
 	NOT_A_PORT,
 	NOT_A_PORT,
-	&PORTB,
-	&PORTC,
-	&PORTD,
+	pinsAddress(PORTB),
+	pinsAddress(PORTC),
+	pinsAddress(PORTD),
 };
 
 const uint16_t PROGMEM port_to_input_PGM[] = {
 	NOT_A_PORT,
 	NOT_A_PORT,
-	&PINB,
-	&PINC,
-	&PIND,
+	pinsAddress(PINB),
+	pinsAddress(PINC),
+	pinsAddress(PIND),
 };
 
 const uint8_t PROGMEM digital_pin_to_port_PGM[] = {
@@ -462,4 +473,70 @@ const uint8_t PROGMEM digital_pin_to_timer_PGM[] = {
 	NOT_ON_TIMER,
 	NOT_ON_TIMER,
 };
+
+const uint8_t PROGMEM interrupt_to_digital_pin_PGM[] = {
+	2, /* INT0, port D */
+	3, /* INT1 */
+};
+#endif
+
+// The hardware pwm channels, indexed by the TIMERxx values in
+// pins_arduino.h.  A channel this chip doesn't have is all zeros.
+#define PWM_CHANNEL(tccr, ocr, com, timer, channel) { pinsAddress(tccr), pinsAddress(ocr), _BV(com), timer, channel }
+#define NO_PWM_CHANNEL { 0, 0, 0, 0, 0 }
+
+const timer_channel PROGMEM timer_channel_PGM[] = {
+	NO_PWM_CHANNEL,					// NOT_ON_TIMER
+#if defined(TCCR0A) && defined(COM0A1)
+	PWM_CHANNEL(TCCR0A, OCR0A, COM0A1, 0, TIMER_CHANNEL_A),		// TIMER0A
+#elif defined(TCCR0) && defined(COM00) && !defined(__AVR_ATmega8__)
+	PWM_CHANNEL(TCCR0, OCR0, COM00, 0, TIMER_CHANNEL_A),
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR0A) && defined(COM0B1)
+	PWM_CHANNEL(TCCR0A, OCR0B, COM0B1, 0, TIMER_CHANNEL_B),		// TIMER0B
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR1A) && defined(COM1A1)
+	PWM_CHANNEL(TCCR1A, OCR1A, COM1A1, 1, TIMER_CHANNEL_A),		// TIMER1A
+#else
+	NO_PWM_CHANNEL,
 #endif
+#if defined(TCCR1A) && defined(COM1B1)
+	PWM_CHANNEL(TCCR1A, OCR1B, COM1B1, 1, TIMER_CHANNEL_B),		// TIMER1B
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR2) && defined(COM21)
+	PWM_CHANNEL(TCCR2, OCR2, COM21, 2, TIMER_CHANNEL_A),		// TIMER2
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR2A) && defined(COM2A1)
+	PWM_CHANNEL(TCCR2A, OCR2A, COM2A1, 2, TIMER_CHANNEL_A),		// TIMER2A
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR2A) && defined(COM2B1)
+	PWM_CHANNEL(TCCR2A, OCR2B, COM2B1, 2, TIMER_CHANNEL_B),		// TIMER2B
+#else
+	NO_PWM_CHANNEL,
+#endif
+#if defined(TCCR3A)
+	PWM_CHANNEL(TCCR3A, OCR3A, COM3A1, 3, TIMER_CHANNEL_A),		// TIMER3A
+	PWM_CHANNEL(TCCR3A, OCR3B, COM3B1, 3, TIMER_CHANNEL_B),		// TIMER3B
+	PWM_CHANNEL(TCCR3A, OCR3C, COM3C1, 3, TIMER_CHANNEL_C),		// TIMER3C
+#endif
+#if defined(TCCR4A)
+	PWM_CHANNEL(TCCR4A, OCR4A, COM4A1, 4, TIMER_CHANNEL_A),		// TIMER4A
+	PWM_CHANNEL(TCCR4A, OCR4B, COM4B1, 4, TIMER_CHANNEL_B),		// TIMER4B
+	PWM_CHANNEL(TCCR4A, OCR4C, COM4C1, 4, TIMER_CHANNEL_C),		// TIMER4C
+#endif
+#if defined(TCCR5A)
+	PWM_CHANNEL(TCCR5A, OCR5A, COM5A1, 5, TIMER_CHANNEL_A),		// TIMER5A
+	PWM_CHANNEL(TCCR5A, OCR5B, COM5B1, 5, TIMER_CHANNEL_B),		// TIMER5B
+	PWM_CHANNEL(TCCR5A, OCR5C, COM5C1, 5, TIMER_CHANNEL_C),		// TIMER5C
+#endif
+};
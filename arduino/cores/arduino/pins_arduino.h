@@ -50,17 +50,34 @@
 #define TIMER5C 16
 
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-const static uint8_t SS   = 53;
-const static uint8_t MOSI = 51;
-const static uint8_t MISO = 50;
-const static uint8_t SCK  = 52;
+static const uint8_t SS   = 53;
+static const uint8_t MOSI = 51;
+static const uint8_t MISO = 50;
+static const uint8_t SCK  = 52;
+static const uint8_t SDA  = 20;
+static const uint8_t SCL  = 21;
 #else
-const static uint8_t SS   = 10;
-const static uint8_t MOSI = 11;
-const static uint8_t MISO = 12;
-const static uint8_t SCK  = 13;
+static const uint8_t SS   = 10;
+static const uint8_t MOSI = 11;
+static const uint8_t MISO = 12;
+static const uint8_t SCK  = 13;
+static const uint8_t SDA  = 18;
+static const uint8_t SCL  = 19;
 #endif
 
+// A hardware pwm channel: the timer control register holding its compare
+// output mode bits (always TCCRnA, or TCCRn on timers that have only one),
+// its output compare register, the mask of the COMnx1 bit that connects
+// it to the pin, the number of the timer and which of its compare
+// channels it is (TIMER_CHANNEL_A, B or C).
+typedef struct {
+	uint16_t tccr;
+	uint16_t ocr;
+	uint8_t com;
+	uint8_t timer;
+	uint8_t channel;
+} timer_channel;
+
 // On the ATmega1280, the addresses of some of the port registers are
 // greater than 255, so we can't store them in uint8_t's.
 extern const uint16_t PROGMEM port_to_mode_PGM[];
@@ -71,6 +88,18 @@ extern const uint8_t PROGMEM digital_pin_to_port_PGM[];
 // extern const uint8_t PROGMEM digital_pin_to_bit_PGM[];
 extern const uint8_t PROGMEM digital_pin_to_bit_mask_PGM[];
 extern const uint8_t PROGMEM digital_pin_to_timer_PGM[];
+extern const uint8_t PROGMEM interrupt_to_digital_pin_PGM[];
+extern const timer_channel PROGMEM timer_channel_PGM[];
+
+// A register from the tables above, and a register as the tables hold
+// it.  The host build (see arduino/host) keeps the registers in an array,
+// and the tables hold offsets into it.
+#define pinsAddress(R) ( (uint16_t) (uintptr_t) &(R) )
+#if defined(ARDUINO_HOST)
+#define pinsRegister(A) ( (A) ? (volatile uint8_t *)( __host_io + (A) ) : (volatile uint8_t *) 0 )
+#else
+#define pinsRegister(A) ( (volatile uint8_t *)(A) )
+#endif
 
 // Get the bit location within the hardware port of the given virtual pin.
 // This comes from the pins_*.c file for the active board configuration.
@@ -80,9 +109,18 @@ extern const uint8_t PROGMEM digital_pin_to_timer_PGM[];
 #define digitalPinToPort(P) ( pgm_read_byte( digital_pin_to_port_PGM + (P) ) )
 #define digitalPinToBitMask(P) ( pgm_read_byte( digital_pin_to_bit_mask_PGM + (P) ) )
 #define digitalPinToTimer(P) ( pgm_read_byte( digital_pin_to_timer_PGM + (P) ) )
+#define interruptToDigitalPin(I) ( pgm_read_byte( interrupt_to_digital_pin_PGM + (I) ) )
 #define analogInPinToBit(P) (P)
-#define portOutputRegister(P) ( (volatile uint8_t *)( pgm_read_word( port_to_output_PGM + (P))) )
-#define portInputRegister(P) ( (volatile uint8_t *)( pgm_read_word( port_to_input_PGM + (P))) )
-#define portModeRegister(P) ( (volatile uint8_t *)( pgm_read_word( port_to_mode_PGM + (P))) )
+#define portOutputRegister(P) ( pinsRegister( pgm_read_word( port_to_output_PGM + (P))) )
+#define portInputRegister(P) ( pinsRegister( pgm_read_word( port_to_input_PGM + (P))) )
+#define portModeRegister(P) ( pinsRegister( pgm_read_word( port_to_mode_PGM + (P))) )
+
+// Look up the hardware pwm channel behind a TIMERxx value.
+#define timerToControlRegister(T) ( pinsRegister( pgm_read_word( &timer_channel_PGM[(T)].tccr ) ) )
+#define timerToCompareRegister(T) ( pinsRegister( pgm_read_word( &timer_channel_PGM[(T)].ocr ) ) )
+#define timerToCompareOutputMask(T) ( pgm_read_byte( &timer_channel_PGM[(T)].com ) )
+#define timerToTimerNumber(T) ( pgm_read_byte( &timer_channel_PGM[(T)].timer ) )
+#define timerToChannel(T) ( pgm_read_byte( &timer_channel_PGM[(T)].channel ) )
+#define timerIs16Bit(N) ( (N) != 0 && (N) != 2 )
 
 #endif
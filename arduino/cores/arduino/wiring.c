@@ -22,6 +22,8 @@
   $Id$
 */
 
+#include <avr/sleep.h>
+
 #include "wiring_private.h"
 
 // the prescaler is set so that timer0 ticks every 64 clock cycles, and the
@@ -41,8 +43,16 @@ volatile unsigned long timer0_overflow_count = 0;
 volatile unsigned long timer0_millis = 0;
 static unsigned char timer0_fract = 0;
 
+// the top halves of 64-bit versions of the two counts above, bumped when
+// they wrap (every 50 and 49.7 days at 16 MHz), for uptimeMicros() and
+// uptimeMillis().  16 bits is plenty: that's 8900 years of millis.
+static volatile unsigned int timer0_overflow_high = 0;
+static volatile unsigned int timer0_millis_high = 0;
+
 SIGNAL(TIMER0_OVF_vect)
 {
+	ISR_ACCOUNT(ISR_ID_TIMER0_OVF);
+
 	// copy these to local variables so they can be stored in registers
 	// (volatile variables must be read from memory on every access)
 	unsigned long m = timer0_millis;
@@ -55,9 +65,15 @@ SIGNAL(TIMER0_OVF_vect)
 		m += 1;
 	}
 
+	// m only gets this small just after it wraps (or at the very start,
+	// which the second test rules out), so this costs one compare
+	if (m < MILLIS_INC + 1 && m < timer0_millis)
+		timer0_millis_high++;
+
 	timer0_fract = f;
 	timer0_millis = m;
-	timer0_overflow_count++;
+	if (++timer0_overflow_count == 0)
+		timer0_overflow_high++;
 }
 
 unsigned long millis()
@@ -67,9 +83,9 @@ unsigned long millis()
 
 	// disable interrupts while we read timer0_millis or we might get an
 	// inconsistent value (e.g. in the middle of a write to timer0_millis)
-	cli();
+	CRITICAL_BEGIN(oldSREG);
 	m = timer0_millis;
-	SREG = oldSREG;
+	CRITICAL_END(oldSREG);
 
 	return m;
 }
@@ -78,7 +94,7 @@ unsigned long micros() {
 	unsigned long m;
 	uint8_t oldSREG = SREG, t;
 	
-	cli();
+	CRITICAL_BEGIN(oldSREG);
 	m = timer0_overflow_count;
 #if defined(TCNT0)
 	t = TCNT0;
@@ -97,9 +113,140 @@ unsigned long micros() {
 		m++;
 #endif
 
-	SREG = oldSREG;
-	
+	CRITICAL_END(oldSREG);
+
+	// (m << 8) is just a move of bytes; at 8 and 16 MHz the scaling by
+	// 64 cycles per tick is a shift too.
+#if F_CPU == 16000000L
+	return ((m << 8) | t) << 2;
+#elif F_CPU == 8000000L
+	return ((m << 8) | t) << 3;
+#else
 	return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
+#endif
+}
+
+// Timer 0 ticks since the program started: one every 64 clock cycles, or 4
+// microseconds at 16 MHz.  That's as fine as timer 0 goes; cycles() (see
+// wiring_cycles.c) counts single clock cycles on timer 1 for anything
+// shorter.  Wraps every 4.9 hours at 16 MHz, and ticks are cheaper than
+// micros() since there's no scaling at all.
+unsigned long ticks()
+{
+	unsigned long m;
+	uint8_t oldSREG = SREG, t;
+
+	CRITICAL_BEGIN(oldSREG);
+	m = timer0_overflow_count;
+#if defined(TCNT0)
+	t = TCNT0;
+#elif defined(TCNT0L)
+	t = TCNT0L;
+#endif
+
+#ifdef TIFR0
+	if ((TIFR0 & _BV(TOV0)) && (t < 255))
+		m++;
+#else
+	if ((TIFR & _BV(TOV0)) && (t < 255))
+		m++;
+#endif
+
+	CRITICAL_END(oldSREG);
+
+	return (m << 8) | t;
+}
+
+// micros() and millis() as 64-bit counts, which take half a million years
+// to wrap, so a plain subtraction or comparison of two readings is always
+// right.  Slower than the 32-bit versions; use those for short intervals.
+unsigned long long uptimeMicros()
+{
+	unsigned long long m;
+	unsigned long lo;
+	unsigned int hi;
+	uint8_t oldSREG = SREG, t;
+
+	CRITICAL_BEGIN(oldSREG);
+	lo = timer0_overflow_count;
+	hi = timer0_overflow_high;
+#if defined(TCNT0)
+	t = TCNT0;
+#elif defined(TCNT0L)
+	t = TCNT0L;
+#endif
+
+#ifdef TIFR0
+	if ((TIFR0 & _BV(TOV0)) && (t < 255))
+#else
+	if ((TIFR & _BV(TOV0)) && (t < 255))
+#endif
+		if (++lo == 0)
+			hi++;
+
+	CRITICAL_END(oldSREG);
+
+	m = ((((unsigned long long) hi << 32) | lo) << 8) | t;
+#if F_CPU == 16000000L
+	return m << 2;
+#elif F_CPU == 8000000L
+	return m << 3;
+#else
+	return m * (64 / clockCyclesPerMicrosecond());
+#endif
+}
+
+unsigned long long uptimeMillis()
+{
+	unsigned long lo;
+	unsigned int hi;
+	uint8_t oldSREG = SREG;
+
+	CRITICAL_BEGIN(oldSREG);
+	lo = timer0_millis;
+	hi = timer0_millis_high;
+	CRITICAL_END(oldSREG);
+
+	return ((unsigned long long) hi << 32) | lo;
+}
+
+static uint8_t idle_mode = IDLE_BUSY;
+
+// Moves millis() and micros() on by n timer 0 overflows that went by with
+// the overflow interrupt masked.  Call with interrupts disabled.
+void timer0Advance(unsigned long n)
+{
+	unsigned long m = timer0_millis;
+	unsigned long f = timer0_fract + n * FRACT_INC;
+
+	m += n * MILLIS_INC + f / FRACT_MAX;
+	timer0_fract = f % FRACT_MAX;
+	if (m < timer0_millis)
+		timer0_millis_high++;
+	timer0_millis = m;
+	if (timer0_overflow_count + n < timer0_overflow_count)
+		timer0_overflow_high++;
+	timer0_overflow_count += n;
+}
+
+// With IDLE_SLEEP, delay() and idle() put the CPU to sleep in idle mode
+// while they wait, instead of spinning: timers, serial and the rest carry
+// on and any interrupt wakes it up, the timer 0 overflow at least once
+// every 1.024 ms (at 16 MHz).  IDLE_BUSY, the default, spins as always.
+void idleMode(uint8_t mode)
+{
+	idle_mode = mode;
+}
+
+// main() calls this after each pass through loop().  With IDLE_SLEEP it
+// sleeps until the next interrupt, so loop() runs once per interrupt
+// rather than flat out; otherwise it does nothing.
+void idle()
+{
+	if (idle_mode == IDLE_SLEEP) {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();
+	}
 }
 
 void delay(unsigned long ms)
@@ -107,9 +254,24 @@ void delay(unsigned long ms)
 	uint16_t start = (uint16_t)micros();
 
 	while (ms > 0) {
-		if (((uint16_t)micros() - start) >= 1000) {
+		if ((uint16_t)((uint16_t)micros() - start) >= 1000) {
 			ms--;
 			start += 1000;
+		} else if (idle_mode == IDLE_SLEEP) {
+			uint8_t oldSREG = SREG;
+
+			// check again with interrupts off, so the interrupt
+			// we're waiting for can't slip in before we sleep; the
+			// instruction after sei always runs first.
+			set_sleep_mode(SLEEP_MODE_IDLE);
+			cli();
+			if ((uint16_t)((uint16_t)micros() - start) < 1000) {
+				sleep_enable();
+				sei();
+				sleep_cpu();
+				sleep_disable();
+			}
+			SREG = oldSREG;
 		}
 	}
 }
@@ -117,6 +279,10 @@ void delay(unsigned long ms)
 /* Delay for the given number of microseconds.  Assumes a 8 or 16 MHz clock. */
 void delayMicroseconds(unsigned int us)
 {
+#if defined(ARDUINO_HOST)
+	// no cycles to count off the avr; see arduino/host
+	_delay_us(us);
+#else
 	// calling avrlib's delay_us() function with low values (e.g. 1 or
 	// 2 microseconds) gives delays longer than desired.
 	//delay_us(us);
@@ -162,6 +328,7 @@ void delayMicroseconds(unsigned int us)
 		"1: sbiw %0,1" "\n\t" // 2 cycles
 		"brne 1b" : "=w" (us) : "0" (us) // 2 cycles
 	);
+#endif
 }
 
 void init()
@@ -266,13 +433,9 @@ void init()
 #endif
 
 #if defined(ADCSRA)
-	// set a2d prescale factor to 128
-	// 16 MHz / 128 = 125 KHz, inside the desired 50-200 KHz range.
-	// XXX: this will not work properly for other clock speeds, and
-	// this code should use F_CPU to determine the prescale factor.
-	sbi(ADCSRA, ADPS2);
-	sbi(ADCSRA, ADPS1);
-	sbi(ADCSRA, ADPS0);
+	// set a2d prescale factor to bring the a2d clock inside the desired
+	// 50-200 KHz range: 128 at 16 MHz (125 KHz), 64 at 8 MHz.
+	ADCSRA |= ADC_PRESCALE;
 
 	// enable a2d conversions
 	sbi(ADCSRA, ADEN);
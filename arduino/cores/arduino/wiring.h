@@ -67,6 +67,31 @@ extern "C"{
 #define DEFAULT 1
 #define EXTERNAL 0
 
+#define IDLE_BUSY 0
+#define IDLE_SLEEP 1
+
+#define PWM_FAST 0
+#define PWM_PHASE_CORRECT 1
+
+// timer owners for timerAcquire(); libraries use TIMER_OWNER_USER and up
+#define TIMER_OWNER_NONE 0
+#define TIMER_OWNER_PWM 1
+#define TIMER_OWNER_MILLIS 2
+#define TIMER_OWNER_TONE 3
+#define TIMER_OWNER_CYCLES 4
+#define TIMER_OWNER_CAPTURE 5
+#define TIMER_OWNER_SOFTPWM 6
+#define TIMER_OWNER_ADC 7
+#define TIMER_OWNER_TICKLESS 8
+#define TIMER_OWNER_SYNTH 9
+#define TIMER_OWNER_SAMPLER 10
+#define TIMER_OWNER_MEMORY 11
+#define TIMER_OWNER_USER 16
+
+#define TIMER_CHANNEL_A 0
+#define TIMER_CHANNEL_B 1
+#define TIMER_CHANNEL_C 2
+
 // undefine stdlib's abs if encountered
 #ifdef abs
 #undef abs
@@ -110,20 +135,209 @@ void pinMode(uint8_t, uint8_t);
 void digitalWrite(uint8_t, uint8_t);
 int digitalRead(uint8_t);
 int analogRead(uint8_t);
+int analogReadFast(uint8_t);
 void analogReference(uint8_t mode);
 void analogWrite(uint8_t, int);
+void pwmWrite(uint8_t, unsigned int);
+unsigned long pwmConfigure(uint8_t pin, unsigned long frequency, uint8_t mode);
+uint8_t pwmResolution(uint8_t pin, uint8_t bits);
+unsigned int pwmTop(uint8_t pin);
+
+uint8_t softPwmAttach(uint8_t pin);
+void softPwmDetach(uint8_t pin);
+void softPwmStage(uint8_t pin, uint8_t duty);
+void softPwmWrite(uint8_t pin, uint8_t duty);
+void softPwmCommit(void);
+
+uint8_t timerAcquire(uint8_t timer, uint8_t owner);
+void timerRelease(uint8_t timer, uint8_t owner);
+uint8_t timerChannelAcquire(uint8_t timer, uint8_t channel, uint8_t owner);
+void timerChannelRelease(uint8_t timer, uint8_t channel, uint8_t owner);
+uint8_t timerOwner(uint8_t timer);
+uint8_t timerChannelOwner(uint8_t timer, uint8_t channel);
+void timer2Overflow(void (*)(void));
 
 unsigned long millis(void);
 unsigned long micros(void);
+unsigned long ticks(void);
+unsigned long long uptimeMicros(void);
+unsigned long long uptimeMillis(void);
+uint8_t cyclesBegin(void);
+void cyclesEnd(void);
+unsigned long cycles(void);
 void delay(unsigned long);
 void delayMicroseconds(unsigned int us);
+void idleMode(uint8_t);
+void idle(void);
+void delayTickless(unsigned long);
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
+uint8_t pulseCaptureStart(uint8_t timer, uint8_t periods);
+uint8_t pulseCaptureReady(uint8_t timer);
+void pulseCaptureStop(uint8_t timer);
+unsigned long pulseCapturePeriod(uint8_t timer);
+unsigned long pulseCaptureHigh(uint8_t timer);
+double pulseCaptureFrequency(uint8_t timer);
+double pulseCaptureDuty(uint8_t timer);
 
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, unsigned int len);
+void shiftInBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buf, unsigned int len);
+
+void enableExternalInterrupt(uint8_t, int mode);
+void disableExternalInterrupt(uint8_t);
+
+// what attachInterrupt() has put on one interrupt number: func, or
+// funcArg(arg).  each number's slot and dispatch handler are in an
+// object of their own (WInterrupts0.c and on), so a sketch links only
+// the handlers for the numbers it attaches, and the rest of the vectors
+// are free for EXTERNAL_INTERRUPT_HANDLER().  that takes a number the
+// compiler can see; any other goes through externalInterruptSlot(),
+// which links every handler.
+typedef struct {
+	void (*func)(void);
+	void (*funcArg)(void *);
+	void *arg;
+} external_interrupt;
+
+extern volatile external_interrupt external_interrupt_0, external_interrupt_1;
+#if defined(EICRA) && defined(EICRB)
+extern volatile external_interrupt external_interrupt_2, external_interrupt_3,
+	external_interrupt_4, external_interrupt_5, external_interrupt_6,
+	external_interrupt_7;
+#endif
+
+volatile external_interrupt *externalInterruptSlot(uint8_t);
+void externalInterruptAttach(volatile external_interrupt *, uint8_t,
+	void (*)(void), void (*)(void *), void *arg, int mode);
+void externalInterruptDetach(volatile external_interrupt *, uint8_t);
+
+static inline volatile external_interrupt *externalInterrupt(uint8_t)
+	__attribute__ ((always_inline));
+static inline volatile external_interrupt *externalInterrupt(uint8_t interruptNum)
+{
+	if (!__builtin_constant_p(interruptNum))
+		return externalInterruptSlot(interruptNum);
+	switch (interruptNum) {
+	case 0: return &external_interrupt_0;
+	case 1: return &external_interrupt_1;
+#if defined(EICRA) && defined(EICRB)
+	case 2: return &external_interrupt_2;
+	case 3: return &external_interrupt_3;
+	case 4: return &external_interrupt_4;
+	case 5: return &external_interrupt_5;
+	case 6: return &external_interrupt_6;
+	case 7: return &external_interrupt_7;
+#endif
+	}
+	return 0;
+}
+
+static inline void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+	__attribute__ ((always_inline));
+static inline void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+	externalInterruptAttach(externalInterrupt(interruptNum), interruptNum, userFunc, 0, 0, mode);
+}
+
+static inline void attachInterruptArg(uint8_t interruptNum, void (*userFunc)(void *), void *arg, int mode)
+	__attribute__ ((always_inline));
+static inline void attachInterruptArg(uint8_t interruptNum, void (*userFunc)(void *), void *arg, int mode)
+{
+	externalInterruptAttach(externalInterrupt(interruptNum), interruptNum, 0, userFunc, arg, mode);
+}
+
+static inline void detachInterrupt(uint8_t interruptNum) __attribute__ ((always_inline));
+static inline void detachInterrupt(uint8_t interruptNum)
+{
+	externalInterruptDetach(externalInterrupt(interruptNum), interruptNum);
+}
+
+// the vector behind each interrupt number, for handlers bound at compile
+// time with EXTERNAL_INTERRUPT_HANDLER(n) and switched on with
+// enableExternalInterrupt(n, mode).  such a handler is a plain ISR, so it
+// saves only the registers it uses rather than everything an indirect call
+// may clobber.  it can go on any number attachInterrupt() isn't used on.
+#if defined(EICRA) && defined(EICRB)
+#define EXTERNAL_INT_0_vect INT4_vect
+#define EXTERNAL_INT_1_vect INT5_vect
+#define EXTERNAL_INT_2_vect INT0_vect
+#define EXTERNAL_INT_3_vect INT1_vect
+#define EXTERNAL_INT_4_vect INT2_vect
+#define EXTERNAL_INT_5_vect INT3_vect
+#define EXTERNAL_INT_6_vect INT6_vect
+#define EXTERNAL_INT_7_vect INT7_vect
+#else
+#define EXTERNAL_INT_0_vect INT0_vect
+#define EXTERNAL_INT_1_vect INT1_vect
+#endif
 
-void attachInterrupt(uint8_t, void (*)(void), int mode);
-void detachInterrupt(uint8_t);
+#define EXTERNAL_INTERRUPT_HANDLER(n) ISR(EXTERNAL_INT_##n##_vect)
+
+// one edge seen by edgeCaptureBegin(): the interrupt number, the pin level
+// just after the edge, and the time from micros() (or from cycles(), after
+// cyclesBegin() and edgeCaptureClock(cycles)).
+typedef struct {
+	uint8_t interrupt;
+	uint8_t level;
+	unsigned long time;
+} edge_event;
+
+uint8_t edgeCaptureAttach(volatile external_interrupt *, uint8_t, int mode);
+
+// inline for the same reason as attachInterrupt()
+static inline uint8_t edgeCaptureBegin(uint8_t interruptNum, int mode) __attribute__ ((always_inline));
+static inline uint8_t edgeCaptureBegin(uint8_t interruptNum, int mode)
+{
+	return edgeCaptureAttach(externalInterrupt(interruptNum), interruptNum, mode);
+}
+
+static inline void edgeCaptureEnd(uint8_t interruptNum) __attribute__ ((always_inline));
+static inline void edgeCaptureEnd(uint8_t interruptNum)
+{
+	detachInterrupt(interruptNum);
+}
+void edgeCaptureClock(unsigned long (*)(void));
+uint8_t edgeAvailable(void);
+uint8_t edgeRead(edge_event *);
+unsigned int edgeOverruns(void);
+
+// a software timer, owned by the caller and run by softTimerRun()
+typedef struct soft_timer {
+	struct soft_timer *next;
+	unsigned long expires;
+	unsigned long period;
+	void (*callback)(void *);
+	void *arg;
+	uint8_t pending;
+} soft_timer;
+
+void softTimerOnce(soft_timer *, unsigned long ms, void (*)(void *), void *arg);
+void softTimerEvery(soft_timer *, unsigned long ms, void (*)(void *), void *arg);
+void softTimerStop(soft_timer *);
+void softTimerRun(void);
+
+// a task for the cooperative scheduler, owned by the caller.  runs,
+// misses, lastMicros and maxMicros are kept up to date for the sketch.
+typedef struct {
+	void (*run)(void *);
+	void *arg;
+	unsigned long period;
+	unsigned long deadline;
+	unsigned long release;
+	uint8_t priority;
+	uint8_t index;
+	uint8_t ready;
+	unsigned long runs;
+	unsigned long misses;
+	unsigned long lastMicros;
+	unsigned long maxMicros;
+} sched_task;
+
+uint8_t taskAdd(sched_task *, void (*)(void *), void *arg, unsigned long period, uint8_t priority);
+void taskDeadline(sched_task *, unsigned long ms);
+void taskRemove(sched_task *);
+uint8_t taskRun(void);
 
 void setup(void);
 void loop(void);
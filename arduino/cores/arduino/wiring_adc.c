@@ -0,0 +1,537 @@
+/*
+  wiring_adc.c - interrupt driven analog input
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include <avr/sleep.h>
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+#include "wiring_adc.h"
+
+#if defined(ADCSRA) && defined(ADATE)
+
+// Everything that runs the ADC from its conversion complete interrupt
+// lives here, since there's only the one vector.  adc_owner says which
+// mode the interrupt is serving.
+
+// selects the channel for the next conversion that starts
+static void adcSelect(uint8_t channel)
+{
+#if defined(ADCSRB) && defined(MUX5)
+	ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+#endif
+	ADMUX = (analog_reference << 6) | (channel & 0x07);
+}
+
+// Scanner.  The ADC free runs, so every conversion starts the moment the
+// previous one ends, with whatever ADMUX held a cycle or so earlier.  By
+// the time the interrupt for one result runs, the next conversion is
+// already under way, and the channel written now is the one after that.
+// scan_done and scan_busy follow the two conversions in flight.
+//
+// Results go into the back half of scan_values; when the last channel in
+// the list comes in, the halves swap and scan_sequence ticks over.  A
+// complete set of readings is therefore always sitting in the front half,
+// and scan_sequence changing tells a reader that it moved.
+//
+// With analogScanResolution() above 10 bits, each channel is oversampled:
+// 4^n passes are summed in scan_sums and the sum shifted right by n, which
+// gives n extra bits as long as there's at least a bit or so of noise on
+// the input to dither it.  The halves then swap once every 4^n passes.
+
+static uint8_t scan_channels[ADC_SCAN_MAX];
+static uint8_t scan_count;
+static uint8_t scan_index[ADC_SCAN_MAX];	// channel to list position
+static uint8_t scan_done;
+static uint8_t scan_busy;
+static volatile uint8_t scan_front;
+static volatile uint8_t scan_sequence;
+static volatile unsigned int scan_values[2][ADC_SCAN_MAX];
+static unsigned long scan_sums[ADC_SCAN_MAX];
+static uint8_t scan_shift;
+static uint8_t scan_extra_bits;
+static unsigned int scan_pass;
+static unsigned int scan_last_pass;
+
+// scan_done for the first conversion, which gets thrown away
+#define SCAN_DISCARD 0xFF
+
+static inline void scanSample(int value)
+{
+	uint8_t i = scan_done;
+
+	if (i != SCAN_DISCARD) {
+		unsigned long sum = scan_sums[i] + value;
+
+		if (scan_pass == scan_last_pass) {
+			scan_values[scan_front ^ 1][i] = sum >> scan_shift;
+			sum = 0;
+		}
+		scan_sums[i] = sum;
+
+		if (i == scan_count - 1) {
+			if (scan_pass == scan_last_pass) {
+				scan_front ^= 1;
+				scan_sequence++;
+				scan_pass = 0;
+			} else {
+				scan_pass++;
+			}
+		}
+	}
+
+	scan_done = scan_busy;
+	if (++scan_busy == scan_count)
+		scan_busy = 0;
+	adcSelect(scan_channels[scan_busy]);
+}
+
+// Stream.  Timer 1 runs in CTC mode at the sample rate and its compare
+// match B auto-triggers each conversion, so samples are spaced by the
+// crystal rather than by whatever else the interrupts are doing.  The
+// trigger is the rising edge of OCF1B, and since nothing services that
+// interrupt, the flag is cleared here to arm the next one.  Samples go
+// into a ring that the sketch drains in batches.
+
+#if !defined(ADC_STREAM_BUFFER_SIZE)
+#if (RAMEND < 1000)
+  #define ADC_STREAM_BUFFER_SIZE 16
+#else
+  #define ADC_STREAM_BUFFER_SIZE 64
+#endif
+#endif
+
+#if (ADC_STREAM_BUFFER_SIZE & (ADC_STREAM_BUFFER_SIZE - 1)) || (ADC_STREAM_BUFFER_SIZE > 256)
+#error ADC_STREAM_BUFFER_SIZE must be a power of two, 256 at most
+#endif
+
+static volatile int stream_buffer[ADC_STREAM_BUFFER_SIZE];
+static volatile uint8_t stream_head;
+static volatile uint8_t stream_tail;
+static volatile unsigned int stream_overruns;
+static uint8_t stream_adps;
+
+static inline void streamSample(int value)
+{
+	uint8_t next = (stream_head + 1) & (ADC_STREAM_BUFFER_SIZE - 1);
+
+	if (next == stream_tail) {
+		stream_overruns++;
+	} else {
+		stream_buffer[stream_head] = value;
+		stream_head = next;
+	}
+
+	TIFR1 = _BV(OCF1B);
+}
+
+// Single conversions, started by analogReadStart() and finished here.
+// The ADC is handed back before the callback runs, so the callback can
+// start the next one.
+
+static volatile uint8_t async_ready;
+static volatile int async_result;
+static void (*async_callback)(int);
+
+static inline void asyncSample(int value)
+{
+	ADCSRA &= ~_BV(ADIE);
+	async_result = value;
+	async_ready = 1;
+	adc_owner = ADC_OWNER_NONE;
+	if (async_callback)
+		async_callback(value);
+}
+
+SIGNAL(ADC_vect)
+{
+	uint8_t low, high;
+
+	// ADCL first; see analogRead()
+	low = ADCL;
+	high = ADCH;
+
+	switch (adc_owner) {
+	case ADC_OWNER_SCAN:
+		scanSample((high << 8) | low);
+		break;
+	case ADC_OWNER_STREAM:
+		streamSample((high << 8) | low);
+		break;
+	case ADC_OWNER_ASYNC:
+		asyncSample((high << 8) | low);
+		break;
+	case ADC_OWNER_OVERSAMPLE:
+		async_result = (high << 8) | low;
+		async_ready = 1;
+		break;
+	}
+}
+
+// Starts converting the given analog pins (or channel numbers) one after
+// the other, continuously, in the background.  Each conversion takes 13
+// ADC clocks, so at the default 125 kHz ADC clock a list of n pins is
+// refreshed every 104 * n microseconds.  Returns 0 if the ADC is already
+// in use or the list is empty or too long.  analogRead() returns -1 until
+// analogScanEnd().
+uint8_t analogScanBegin(const uint8_t *pins, uint8_t count)
+{
+	uint8_t i;
+
+	if (count == 0 || count > ADC_SCAN_MAX)
+		return 0;
+
+	if (!adcAcquire(ADC_OWNER_SCAN))
+		return 0;
+
+	for (i = 0; i < ADC_SCAN_MAX; i++)
+		scan_index[i] = 0xFF;
+	for (i = 0; i < count; i++) {
+		scan_channels[i] = analogInputToChannel(pins[i]) & (ADC_SCAN_MAX - 1);
+		scan_index[scan_channels[i]] = i;
+		scan_values[0][i] = scan_values[1][i] = 0;
+		scan_sums[i] = 0;
+	}
+	scan_count = count;
+	scan_shift = scan_extra_bits;
+	scan_last_pass = (1 << (2 * scan_extra_bits)) - 1;
+	scan_pass = 0;
+
+	// the second conversion repeats the first channel, since ADMUX can't
+	// be changed in time for it; the first is dropped, so that channel
+	// isn't counted twice in the first pass
+	scan_done = SCAN_DISCARD;
+	scan_busy = 0;
+	scan_front = 0;
+
+	adcSelect(scan_channels[0]);
+#if defined(ADCSRB) && defined(ADTS0)
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));	// free running
+#endif
+	ADCSRA |= _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | _BV(ADSC);
+
+	return 1;
+}
+
+// Stops the scan, waiting for the conversion in progress, and hands the
+// ADC back to analogRead().  The last readings remain available.
+void analogScanEnd()
+{
+	if (adc_owner != ADC_OWNER_SCAN)
+		return;
+
+	ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+	while (bit_is_set(ADCSRA, ADSC))
+		;
+	ADCSRA |= _BV(ADIF);
+	adc_owner = ADC_OWNER_NONE;
+}
+
+// Sets the resolution of the scanner's readings, from 10 (the default)
+// to 16 bits, for the next analogScanBegin().  Each extra bit costs four
+// times as many conversions per reading: at 16 bits, 4096 of them, about
+// 0.43 seconds per pass through the list at the default ADC clock.
+void analogScanResolution(uint8_t bits)
+{
+	if (bits < 10)
+		bits = 10;
+	if (bits > 16)
+		bits = 16;
+	scan_extra_bits = bits - 10;
+}
+
+// The most recent reading of a scanned pin, or -1 if it isn't in the list.
+long analogScanRead(uint8_t pin)
+{
+	uint8_t i = scan_index[analogInputToChannel(pin) & (ADC_SCAN_MAX - 1)];
+	uint8_t oldSREG = SREG;
+	unsigned int value;
+
+	if (i >= scan_count)
+		return -1;
+
+	cli();
+	value = scan_values[scan_front][i];
+	SREG = oldSREG;
+
+	return value;
+}
+
+// Counts completed passes through the list, wrapping at 256.
+uint8_t analogScanSequence()
+{
+	return scan_sequence;
+}
+
+// Copies one complete pass, in list order, into values and returns its
+// sequence number.  Interrupts stay on; if a pass finishes during the
+// copy, it's simply taken again.
+uint8_t analogScanSnapshot(unsigned int *values)
+{
+	uint8_t seq, front, i;
+
+	do {
+		seq = scan_sequence;
+		front = scan_front;
+		for (i = 0; i < scan_count; i++)
+			values[i] = scan_values[front][i];
+	} while (seq != scan_sequence);
+
+	return seq;
+}
+
+// Samples an analog pin at a fixed rate, in samples per second, until
+// analogStreamEnd().  Timer 1 is taken over for the duration, so PWM on
+// its pins stops and cycles() is unavailable.  The ADC clock is raised if
+// needed to fit a conversion into each period; above about 5000 samples
+// per second that puts it past the 200 kHz the datasheet recommends for
+// full 10-bit accuracy.  Returns the rate actually obtained, which differs
+// from the one asked for when F_CPU doesn't divide evenly, or 0 if the
+// ADC or timer 1 is in use or the rate is out of reach.
+unsigned long analogStreamBegin(uint8_t pin, unsigned long rate)
+{
+	unsigned long top;
+	uint8_t cs = _BV(CS10);
+	uint8_t adps;
+
+	if (rate == 0 || F_CPU / 16 < 14 * rate)
+		return 0;
+
+	top = F_CPU / rate;
+	if (top > 65536UL) {
+		top = F_CPU / 8 / rate;
+		cs = _BV(CS11);
+		if (top > 65536UL)
+			return 0;
+	}
+
+	if (!timerAcquire(1, TIMER_OWNER_ADC))
+		return 0;
+	if (!adcAcquire(ADC_OWNER_STREAM)) {
+		timerRelease(1, TIMER_OWNER_ADC);
+		return 0;
+	}
+
+	stream_head = stream_tail = 0;
+	stream_overruns = 0;
+
+	// the slowest ADC clock that still gets an auto-triggered conversion
+	// (13.5 ADC clocks) done within the sample period
+	stream_adps = ADCSRA & (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0));
+	adps = 7;
+	while (adps > 4 && F_CPU / (1UL << adps) < 14 * rate)
+		adps--;
+	ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | adps;
+
+	// ctc with OCR1A as top, compare B at the end of each period
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TCNT1 = 0;
+	OCR1A = top - 1;
+	OCR1B = top - 1;
+	TIFR1 = _BV(OCF1B);
+
+	adcSelect(analogInputToChannel(pin));
+#if defined(ADCSRB) && defined(ADTS0)
+	ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | _BV(ADTS2) | _BV(ADTS0);
+#endif
+	ADCSRA |= _BV(ADATE) | _BV(ADIF) | _BV(ADIE);
+
+	TCCR1B = _BV(WGM12) | cs;
+
+	return F_CPU / (cs == _BV(CS10) ? 1 : 8) / top;
+}
+
+void analogStreamEnd()
+{
+	if (adc_owner != ADC_OWNER_STREAM)
+		return;
+
+	ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+	while (bit_is_set(ADCSRA, ADSC))
+		;
+	ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | _BV(ADIF) | stream_adps;
+#if defined(ADCSRB) && defined(ADTS0)
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+#endif
+
+	// put timer 1 back the way init() left it: prescale factor 64,
+	// 8-bit phase correct pwm
+	TCCR1B = _BV(CS11) | _BV(CS10);
+	TCCR1A = _BV(WGM10);
+	pwm_top[1] = 255;
+	timerRelease(1, TIMER_OWNER_ADC);
+
+	adc_owner = ADC_OWNER_NONE;
+}
+
+unsigned int analogStreamAvailable()
+{
+	return (uint8_t)(stream_head - stream_tail) & (ADC_STREAM_BUFFER_SIZE - 1);
+}
+
+// Moves up to len samples, oldest first, out of the ring into buf and
+// returns how many there were.
+unsigned int analogStreamRead(int *buf, unsigned int len)
+{
+	uint8_t head = stream_head;
+	uint8_t tail = stream_tail;
+	unsigned int n = 0;
+
+	while (tail != head && n < len) {
+		buf[n++] = stream_buffer[tail];
+		tail = (tail + 1) & (ADC_STREAM_BUFFER_SIZE - 1);
+	}
+	stream_tail = tail;
+
+	return n;
+}
+
+// Samples dropped because the ring was full, since analogStreamBegin().
+unsigned int analogStreamOverruns()
+{
+	uint8_t oldSREG = SREG;
+	unsigned int n;
+
+	cli();
+	n = stream_overruns;
+	SREG = oldSREG;
+
+	return n;
+}
+
+// Starts a conversion on an analog pin and returns without waiting for
+// it; the result is ready about 104 microseconds later at the default ADC
+// clock.  Poll analogReadReady() and collect it with analogReadResult(), or
+// have it passed to the analogReadCallback() function from the interrupt.
+// Returns 0 if the ADC is busy, including with an earlier analogReadStart().
+// An analogRead() called meanwhile waits for this conversion to finish.
+uint8_t analogReadStart(uint8_t pin)
+{
+	if (!adcAcquire(ADC_OWNER_ASYNC))
+		return 0;
+
+	async_ready = 0;
+	adcSelect(analogInputToChannel(pin));
+	ADCSRA |= _BV(ADIF) | _BV(ADIE) | _BV(ADSC);
+
+	return 1;
+}
+
+uint8_t analogReadReady()
+{
+	return async_ready;
+}
+
+// The result of the last analogReadStart(), or -1 if it isn't in yet.
+int analogReadResult()
+{
+	uint8_t oldSREG = SREG;
+	int value = -1;
+
+	cli();
+	if (async_ready)
+		value = async_result;
+	SREG = oldSREG;
+
+	return value;
+}
+
+// Called from the ADC interrupt with each analogReadStart() result; pass
+// 0 to go back to polling.
+void analogReadCallback(void (*callback)(int))
+{
+	async_callback = callback;
+}
+
+// A single reading of 11 to 16 bits, taken by summing 4^n conversions and
+// shifting the sum right by n, for n extra bits over the ADC's 10.  With
+// sleep true, the CPU is put in ADC noise reduction mode for each
+// conversion, which starts it and keeps the CPU's own switching noise out
+// of the result.  Timer 0 stops while the CPU sleeps, so millis() and
+// micros() fall behind by about 100 microseconds per conversion: 0.43
+// seconds for a 16-bit reading.  With interrupts off (in an ISR, say) the
+// conversions are polled instead, and sleep isn't allowed since nothing
+// could wake the CPU.  Returns -1 if the ADC is busy, or for sleep with
+// interrupts off.
+long analogReadOversample(uint8_t pin, uint8_t bits, uint8_t sleep)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t poll = !(oldSREG & _BV(SREG_I));
+	unsigned long sum = 0;
+	unsigned int n;
+	uint8_t extra, low;
+
+	if (bits < 10)
+		bits = 10;
+	if (bits > 16)
+		bits = 16;
+	extra = bits - 10;
+
+	if (sleep && poll)
+		return -1;
+	if (!adcAcquire(ADC_OWNER_OVERSAMPLE))
+		return -1;
+
+	adcSelect(analogInputToChannel(pin));
+	if (sleep)
+		set_sleep_mode(SLEEP_MODE_ADC);
+
+	for (n = 1 << (2 * extra); n > 0; n--) {
+		if (poll) {
+			// no interrupt is coming, so watch the flag
+			ADCSRA |= _BV(ADIF) | _BV(ADSC);
+			while (!(ADCSRA & _BV(ADIF)))
+				;
+			// ADCL first; see analogRead()
+			low = ADCL;
+			sum += (ADCH << 8) | low;
+			continue;
+		}
+		async_ready = 0;
+		ADCSRA |= _BV(ADIF) | _BV(ADIE);
+		if (sleep) {
+			// other interrupts wake us early; sleeping again while
+			// the conversion runs doesn't start another.
+			cli();
+			sleep_enable();
+			while (!async_ready) {
+				sei();
+				sleep_cpu();
+				cli();
+			}
+			sleep_disable();
+			SREG = oldSREG;
+		} else {
+			ADCSRA |= _BV(ADSC);
+			while (!async_ready)
+				;
+		}
+		sum += async_result;
+	}
+
+	ADCSRA &= ~_BV(ADIE);
+	adc_owner = ADC_OWNER_NONE;
+
+	return sum >> extra;
+}
+
+#endif
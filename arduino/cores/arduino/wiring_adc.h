@@ -0,0 +1,67 @@
+/*
+  wiring_adc.h - interrupt driven analog input
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#ifndef WiringADC_h
+#define WiringADC_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define ADC_SCAN_MAX 16
+#else
+#define ADC_SCAN_MAX 8
+#endif
+
+uint8_t analogScanBegin(const uint8_t *pins, uint8_t count);
+void analogScanEnd(void);
+void analogScanResolution(uint8_t bits);
+long analogScanRead(uint8_t pin);
+uint8_t analogScanSequence(void);
+uint8_t analogScanSnapshot(unsigned int *values);
+
+unsigned long analogStreamBegin(uint8_t pin, unsigned long rate);
+void analogStreamEnd(void);
+unsigned int analogStreamAvailable(void);
+unsigned int analogStreamRead(int *buf, unsigned int len);
+unsigned int analogStreamOverruns(void);
+
+uint8_t analogReadStart(uint8_t pin);
+uint8_t analogReadReady(void);
+int analogReadResult(void);
+void analogReadCallback(void (*callback)(int));
+
+long analogReadOversample(uint8_t pin, uint8_t bits, uint8_t sleep);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#ifdef __cplusplus
+class Print;
+unsigned int analogStreamWrite(Print &out, unsigned int len = 0xFFFF);
+#endif
+
+#endif
@@ -28,6 +28,7 @@
 #include "pins_arduino.h"
 
 uint8_t analog_reference = DEFAULT;
+volatile uint8_t adc_owner = ADC_OWNER_NONE;
 
 void analogReference(uint8_t mode)
 {
@@ -37,15 +38,40 @@ void analogReference(uint8_t mode)
 	analog_reference = mode;
 }
 
+// Takes the ADC for owner if nobody has it.  Returns 0 if it's taken.
+uint8_t adcAcquire(uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t ok = 0;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (adc_owner == ADC_OWNER_NONE) {
+		adc_owner = owner;
+		ok = 1;
+	}
+	CRITICAL_END(oldSREG);
+
+	return ok;
+}
+
+// waits out an asynchronous conversion; gives up (returning 0) if the
+// scanner or the stream has the ADC to itself.
+static uint8_t adcAcquireRead()
+{
+	while (!adcAcquire(ADC_OWNER_READ))
+		if (adc_owner != ADC_OWNER_ASYNC)
+			return 0;
+	return 1;
+}
+
 int analogRead(uint8_t pin)
 {
 	uint8_t low, high;
 
-#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-	if (pin >= 54) pin -= 54; // allow for channel or pin numbers
-#else
-	if (pin >= 14) pin -= 14; // allow for channel or pin numbers
-#endif
+	if (!adcAcquireRead())
+		return -1;
+
+	pin = analogInputToChannel(pin); // allow for channel or pin numbers
 
 #if defined(ADCSRB) && defined(MUX5)
 	// the MUX5 bit of ADCSRB selects whether we're reading from channels
@@ -82,178 +108,145 @@ int analogRead(uint8_t pin)
 	high = 0;
 #endif
 
+	adc_owner = ADC_OWNER_NONE;
+
 	// combine the two bytes
 	return (high << 8) | low;
 }
 
+// An 8-bit reading in about 13 microseconds, against 104 for analogRead()
+// at 16 MHz: the ADC is clocked at around 1 MHz, well past what it's
+// specified for at 10 bits, and only the top eight bits of the result are
+// kept, left adjusted so a single read of ADCH gets them.  Returns 0-255,
+// or -1 if the ADC is busy elsewhere.
+int analogReadFast(uint8_t pin)
+{
+#if defined(ADCSRA) && defined(ADCH) && defined(ADLAR)
+	uint8_t adcsra;
+	uint8_t value;
+
+	if (!adcAcquireRead())
+		return -1;
+
+	pin = analogInputToChannel(pin);
+
+#if defined(ADCSRB) && defined(MUX5)
+	ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+#endif
+	ADMUX = (analog_reference << 6) | _BV(ADLAR) | (pin & 0x07);
+
+	adcsra = ADCSRA;
+	ADCSRA = (adcsra & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | ADC_FAST_PRESCALE | _BV(ADSC);
+	while (bit_is_set(ADCSRA, ADSC));
+	value = ADCH;
+	ADCSRA = adcsra;
+
+	adc_owner = ADC_OWNER_NONE;
+
+	return value;
+#else
+	return 0;
+#endif
+}
+
+// The duty cycle that means always on, for each timer.  init() sets them
+// all up as 8-bit pwm; pwmConfigure() and pwmResolution() change it.
+unsigned int pwm_top[6] = { 255, 255, 255, 255, 255, 255 };
+
 // Right now, PWM output only works on the pins with
 // hardware support.  These are defined in the appropriate
 // pins_*.c file.  For the rest of the pins, we default
 // to digital output.
 void analogWrite(uint8_t pin, int val)
 {
+	pwmWrite(pin, val);
+}
+
+// analogWrite() with the full range of a timer set to more than 8 bits:
+// 0 to pwmTop(pin).
+void pwmWrite(uint8_t pin, unsigned int val)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	volatile uint8_t *tccr = 0;
+	volatile uint8_t *ocr;
+	uint8_t n = 0;
+
+	if (timer != NOT_ON_TIMER)
+		tccr = timerToControlRegister(timer);
+
+	if (tccr != 0)
+	{
+		n = timerToTimerNumber(timer);
+		ocr = timerToCompareRegister(timer);
+
+		// connected by an earlier call and not turned off since
+		// (digitalWrite() gives the channel back, and nothing can
+		// take the timer while we hold it): only the duty to change
+		if (val != 0 && val < pwm_top[n] &&
+		    timerChannelOwner(n, timerToChannel(timer)) == TIMER_OWNER_PWM)
+		{
+			if (timerIs16Bit(n)) {
+				uint8_t oldSREG = SREG;
+
+				// the 16-bit registers share a temporary
+				// byte with every other 16-bit access,
+				// interrupts included
+				CRITICAL_BEGIN(oldSREG);
+				*(volatile uint16_t *) ocr = val;
+				CRITICAL_END(oldSREG);
+			} else {
+				*ocr = val;
+			}
+			return;
+		}
+	}
+
 	// We need to make sure the PWM output is enabled for those pins
 	// that support it, as we turn it off when digitally reading or
 	// writing with them.  Also, make sure the pin is in output mode
 	// for consistenty with Wiring, which doesn't require a pinMode
 	// call for the analog output pins.
 	pinMode(pin, OUTPUT);
+
+	if (tccr == 0)
+	{
+		if (val < 128) {
+			digitalWrite(pin, LOW);
+		} else {
+			digitalWrite(pin, HIGH);
+		}
+		return;
+	}
+
 	if (val == 0)
 	{
 		digitalWrite(pin, LOW);
 	}
-	else if (val == 255)
+	else if (val >= pwm_top[n])
 	{
 		digitalWrite(pin, HIGH);
 	}
-	else
+	else if (!timerChannelAcquire(n, timerToChannel(timer), TIMER_OWNER_PWM))
 	{
-		switch(digitalPinToTimer(pin))
-		{
-			// XXX fix needed for atmega8
-			#if defined(TCCR0) && defined(COM00) && !defined(__AVR_ATmega8__)
-			case TIMER0A:
-				// connect pwm to pin on timer 0
-				sbi(TCCR0, COM00);
-				OCR0 = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR0A) && defined(COM0A1)
-			case TIMER0A:
-				// connect pwm to pin on timer 0, channel A
-				sbi(TCCR0A, COM0A1);
-				OCR0A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR0A) && defined(COM0B1)
-			case TIMER0B:
-				// connect pwm to pin on timer 0, channel B
-				sbi(TCCR0A, COM0B1);
-				OCR0B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR1A) && defined(COM1A1)
-			case TIMER1A:
-				// connect pwm to pin on timer 1, channel A
-				sbi(TCCR1A, COM1A1);
-				OCR1A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR1A) && defined(COM1B1)
-			case TIMER1B:
-				// connect pwm to pin on timer 1, channel B
-				sbi(TCCR1A, COM1B1);
-				OCR1B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR2) && defined(COM21)
-			case TIMER2:
-				// connect pwm to pin on timer 2
-				sbi(TCCR2, COM21);
-				OCR2 = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR2A) && defined(COM2A1)
-			case TIMER2A:
-				// connect pwm to pin on timer 2, channel A
-				sbi(TCCR2A, COM2A1);
-				OCR2A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR2A) && defined(COM2B1)
-			case TIMER2B:
-				// connect pwm to pin on timer 2, channel B
-				sbi(TCCR2A, COM2B1);
-				OCR2B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR3A) && defined(COM3A1)
-			case TIMER3A:
-				// connect pwm to pin on timer 3, channel A
-				sbi(TCCR3A, COM3A1);
-				OCR3A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR3A) && defined(COM3B1)
-			case TIMER3B:
-				// connect pwm to pin on timer 3, channel B
-				sbi(TCCR3A, COM3B1);
-				OCR3B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR3A) && defined(COM3C1)
-			case TIMER3C:
-				// connect pwm to pin on timer 3, channel C
-				sbi(TCCR3A, COM3C1);
-				OCR3C = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR4A) && defined(COM4A1)
-			case TIMER4A:
-				// connect pwm to pin on timer 4, channel A
-				sbi(TCCR4A, COM4A1);
-				OCR4A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR4A) && defined(COM4B1)
-			case TIMER4B:
-				// connect pwm to pin on timer 4, channel B
-				sbi(TCCR4A, COM4B1);
-				OCR4B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR4A) && defined(COM4C1)
-			case TIMER4C:
-				// connect pwm to pin on timer 4, channel C
-				sbi(TCCR4A, COM4C1);
-				OCR4C = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR5A) && defined(COM5A1)
-			case TIMER5A:
-				// connect pwm to pin on timer 5, channel A
-				sbi(TCCR5A, COM5A1);
-				OCR5A = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR5A) && defined(COM5B1)
-			case TIMER5B:
-				// connect pwm to pin on timer 5, channel B
-				sbi(TCCR5A, COM5B1);
-				OCR5B = val; // set pwm duty
-				break;
-			#endif
-
-			#if defined(TCCR5A) && defined(COM5C1)
-			case TIMER5C:
-				// connect pwm to pin on timer 5, channel C
-				sbi(TCCR5A, COM5C1);
-				OCR5C = val; // set pwm duty
-				break;
-			#endif
-
-			case NOT_ON_TIMER:
-			default:
-				if (val < 128) {
-					digitalWrite(pin, LOW);
-				} else {
-					digitalWrite(pin, HIGH);
-				}
+		// the timer has been taken over (by tone(), say); treat the
+		// pin like one without pwm rather than disturb it
+		if (val <= pwm_top[n] / 2) {
+			digitalWrite(pin, LOW);
+		} else {
+			digitalWrite(pin, HIGH);
 		}
 	}
+	else
+	{
+		uint8_t oldSREG = SREG;
+
+		// connect pwm to the pin and set the duty
+		CRITICAL_BEGIN(oldSREG);
+		*tccr |= timerToCompareOutputMask(timer);
+		if (timerIs16Bit(n))
+			*(volatile uint16_t *) ocr = val;
+		else
+			*ocr = val;
+		CRITICAL_END(oldSREG);
+	}
 }
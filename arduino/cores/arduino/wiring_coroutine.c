@@ -0,0 +1,200 @@
+/*
+  wiring_coroutine.c - stackful coroutines
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+#include "wiring_coroutine.h"
+
+// Each coroutine keeps its own stack; switching saves the registers a
+// function has to preserve (r2-r17 and r28-r29) on the stack being left,
+// swaps the stack pointer and restores them from the other stack.  The
+// rest are saved by the compiler around the call, as for any function.
+//
+// A switch is 18 pushes, 18 pops, two stack pointer moves, the call and
+// the return: 92 cycles on a 2-byte PC part, 94 on the ATmega2560.  A
+// yield() and the resume that follows cost about 190 cycles in all, 12
+// microseconds at 16 MHz, along with the scheduler's pass over the list.
+
+#define COROUTINE_READY 0
+#define COROUTINE_SLEEPING 1
+#define COROUTINE_WAITING 2
+#define COROUTINE_DONE 3
+
+static coroutine *coroutine_list;
+static coroutine *coroutine_current;
+static void *coroutine_main_sp;
+
+// The switch only touches its parameters from assembly, so as far as
+// gcc can see they're unused; a static function's could then be dropped
+// or rewritten by the interprocedural passes, and its callers would stop
+// loading r24 and r22.  Hence not static, and noipa where gcc has it.
+#if __GNUC__ >= 8
+#define COROUTINE_SWITCH_ATTRIBUTES naked, noinline, used, noipa
+#else
+#define COROUTINE_SWITCH_ATTRIBUTES naked, noinline, used
+#endif
+
+// saves the registers and stack pointer into *from and carries on with
+// the stack saved in to.  (from in r25:r24, to in r23:r22.)
+void coroutineSwitch(void **from, void *to) __attribute__ ((COROUTINE_SWITCH_ATTRIBUTES));
+void coroutineSwitch(void **from, void *to)
+{
+	asm volatile(
+		"push r2\n\t"  "push r3\n\t"  "push r4\n\t"  "push r5\n\t"
+		"push r6\n\t"  "push r7\n\t"  "push r8\n\t"  "push r9\n\t"
+		"push r10\n\t" "push r11\n\t" "push r12\n\t" "push r13\n\t"
+		"push r14\n\t" "push r15\n\t" "push r16\n\t" "push r17\n\t"
+		"push r28\n\t" "push r29\n\t"
+		"movw r30, r24\n\t"
+		"in r0, __SP_L__\n\t"
+		"st Z, r0\n\t"
+		"in r0, __SP_H__\n\t"
+		"std Z+1, r0\n\t"
+		// the write to SREG holds off interrupts for one more
+		// instruction, so the pointer is never seen half changed
+		"in r0, __SREG__\n\t"
+		"cli\n\t"
+		"out __SP_H__, r23\n\t"
+		"out __SREG__, r0\n\t"
+		"out __SP_L__, r22\n\t"
+		"pop r29\n\t"  "pop r28\n\t"
+		"pop r17\n\t"  "pop r16\n\t"  "pop r15\n\t"  "pop r14\n\t"
+		"pop r13\n\t"  "pop r12\n\t"  "pop r11\n\t"  "pop r10\n\t"
+		"pop r9\n\t"   "pop r8\n\t"   "pop r7\n\t"   "pop r6\n\t"
+		"pop r5\n\t"   "pop r4\n\t"   "pop r3\n\t"   "pop r2\n\t"
+		"ret\n\t"
+		::
+	);
+}
+
+// where a new coroutine's first switch returns to
+static void coroutineEntry()
+{
+	coroutine *c = coroutine_current;
+
+	c->fn(c->arg);
+	c->state = COROUTINE_DONE;
+	for (;;)
+		yield();
+}
+
+// Starts fn(arg) as a coroutine running on the given stack; it first
+// runs at the next pass of the scheduler.  The coroutine struct and the
+// stack must stay put until fn returns.
+void coroutineStart(coroutine *c, void (*fn)(void *), void *arg, uint8_t *stack, unsigned int size)
+{
+	uint8_t *sp = stack + size - 1;
+	uint16_t pc = (uint16_t) coroutineEntry;
+	uint8_t i;
+
+	// a frame that looks as if coroutineSwitch() had been called from
+	// coroutineEntry(): the return address, high byte lowest, under the
+	// 18 saved registers.
+	*sp-- = pc & 0xFF;
+	*sp-- = pc >> 8;
+#if defined(__AVR_3_BYTE_PC__)
+	*sp-- = 0;
+#endif
+	for (i = 0; i < 18; i++)
+		*sp-- = 0;
+
+	c->sp = sp;
+	c->fn = fn;
+	c->arg = arg;
+	c->state = COROUTINE_READY;
+	c->event = 0;
+	c->next = coroutine_list;
+	coroutine_list = c;
+}
+
+// Resumes each coroutine that isn't waiting, once, and forgets the ones
+// that have finished.  Returns 0 if there are none.
+uint8_t coroutineRun()
+{
+	coroutine **p = &coroutine_list;
+
+	if (coroutine_list == 0)
+		return 0;
+
+	while (*p) {
+		coroutine *c = *p;
+
+		if (c->state == COROUTINE_SLEEPING && (long) (millis() - c->wake) >= 0)
+			c->state = COROUTINE_READY;
+		if (c->state == COROUTINE_WAITING && *c->event)
+			c->state = COROUTINE_READY;
+
+		if (c->state == COROUTINE_READY) {
+			coroutine_current = c;
+			coroutineSwitch(&coroutine_main_sp, c->sp);
+			coroutine_current = 0;
+		}
+
+		if (c->state == COROUTINE_DONE)
+			*p = c->next;
+		else
+			p = &c->next;
+	}
+
+	return 1;
+}
+
+// Gives the other coroutines and loop() a turn.  Does nothing outside a
+// coroutine.
+void yield()
+{
+	coroutine *c = coroutine_current;
+
+	if (c)
+		coroutineSwitch(&c->sp, coroutine_main_sp);
+}
+
+// Waits ms milliseconds.  In a coroutine, everything else carries on in
+// the meantime; elsewhere it's just delay().
+void await_ms(unsigned long ms)
+{
+	coroutine *c = coroutine_current;
+
+	if (c == 0) {
+		delay(ms);
+		return;
+	}
+	c->wake = millis() + ms;
+	c->state = COROUTINE_SLEEPING;
+	yield();
+}
+
+// Waits for a flag, typically set by an interrupt handler, to become
+// non-zero, then clears it.
+void await_event(volatile uint8_t *flag)
+{
+	coroutine *c = coroutine_current;
+
+	if (c) {
+		c->event = flag;
+		c->state = COROUTINE_WAITING;
+		yield();
+	} else {
+		while (!*flag)
+			;
+	}
+	*flag = 0;
+}
@@ -0,0 +1,98 @@
+/*
+  wiring_coroutine.h - protothreads and coroutines
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#ifndef WiringCoroutine_h
+#define WiringCoroutine_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Protothreads: a function that can wait in the middle and pick up where
+// it left off next time it's called, with no stack of its own.  Locals
+// don't survive a wait, so keep state in the pt or in statics; don't
+// wait inside a switch statement, or twice on one line.  Call the function
+// from loop() (or a task) until it returns PT_ENDED.
+//
+//	char heater(pt *p)
+//	{
+//		PT_BEGIN(p);
+//		setpoint = 150;
+//		PT_WAIT_UNTIL(p, temperature >= 150);
+//		PT_AWAIT_MS(p, 90000);
+//		setpoint = 220;
+//		PT_END(p);
+//	}
+
+typedef struct {
+	unsigned int lc;
+	unsigned long start;
+} pt;
+
+#define PT_WAITING 0
+#define PT_ENDED 1
+
+#define PT_INIT(p) ((p)->lc = 0)
+#define PT_BEGIN(p) switch ((p)->lc) { case 0:
+#define PT_END(p) } (p)->lc = 0; return PT_ENDED
+#define PT_WAIT_UNTIL(p, c) do { (p)->lc = __LINE__; case __LINE__: if (!(c)) return PT_WAITING; } while (0)
+#define PT_YIELD(p) do { (p)->lc = __LINE__; return PT_WAITING; case __LINE__:; } while (0)
+#define PT_AWAIT_MS(p, ms) do { (p)->start = millis(); PT_WAIT_UNTIL(p, millis() - (p)->start >= (ms)); } while (0)
+#define PT_AWAIT_EVENT(p, flag) do { PT_WAIT_UNTIL(p, (flag)); (flag) = 0; } while (0)
+
+// Coroutines: functions that run on their own small stacks and can
+// yield() from any depth of calls, with locals intact.  main() resumes
+// each one in turn between passes through loop().  The stack must hold
+// the deepest chain of calls plus the biggest interrupt handler, which
+// pushes its registers onto whatever stack it finds; 128 bytes is a
+// reasonable start.
+//
+//	COROUTINE_STACK(heaterStack, 128);
+//	coroutine heaterCo;
+//	...
+//	coroutineStart(&heaterCo, heater, 0, heaterStack, sizeof(heaterStack));
+
+#define COROUTINE_STACK(name, size) static uint8_t name[size]
+
+typedef struct coroutine {
+	struct coroutine *next;
+	void *sp;
+	void (*fn)(void *);
+	void *arg;
+	uint8_t state;
+	unsigned long wake;
+	volatile uint8_t *event;
+} coroutine;
+
+void coroutineStart(coroutine *, void (*)(void *), void *arg, uint8_t *stack, unsigned int size);
+uint8_t coroutineRun(void);
+void yield(void);
+void await_ms(unsigned long ms);
+void await_event(volatile uint8_t *flag);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
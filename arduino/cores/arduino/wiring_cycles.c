@@ -0,0 +1,100 @@
+/*
+  wiring_cycles.c - free-running cpu cycle counter on timer 1
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+
+// cyclesBegin() takes timer 1 away from hardware pwm: it runs in normal
+// mode with no prescaler, so TCNT1 counts cpu cycles and the overflow
+// handler extends it to 32 bits (wrapping after 268 seconds at 16 MHz).
+// It fails, returning 0, if timer 1 is in use (see timerAcquire()).
+
+#if defined(TIMSK1)
+#define TIMER1_MASK_REG TIMSK1
+#define TIMER1_FLAG_REG TIFR1
+#else
+#define TIMER1_MASK_REG TIMSK
+#define TIMER1_FLAG_REG TIFR
+#endif
+
+volatile unsigned int timer1_overflow_count = 0;
+
+SIGNAL(TIMER1_OVF_vect)
+{
+	timer1_overflow_count++;
+}
+
+uint8_t cyclesBegin()
+{
+	uint8_t oldSREG = SREG;
+
+	// already counting: leave the count alone for whoever started it
+	if (timerOwner(1) == TIMER_OWNER_CYCLES)
+		return 1;
+	if (!timerAcquire(1, TIMER_OWNER_CYCLES))
+		return 0;
+
+	cli();
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+	TCNT1 = 0;
+	timer1_overflow_count = 0;
+	TIMER1_FLAG_REG = _BV(TOV1);
+	sbi(TIMER1_MASK_REG, TOIE1);
+	SREG = oldSREG;
+
+	return 1;
+}
+
+void cyclesEnd()
+{
+	if (timerOwner(1) != TIMER_OWNER_CYCLES)
+		return;
+
+	cbi(TIMER1_MASK_REG, TOIE1);
+
+	// put timer 1 back the way init() left it: prescale factor 64,
+	// 8-bit phase correct pwm
+	TCCR1B = _BV(CS11) | _BV(CS10);
+	TCCR1A = _BV(WGM10);
+	pwm_top[1] = 255;
+	timerRelease(1, TIMER_OWNER_CYCLES);
+}
+
+unsigned long cycles()
+{
+	unsigned int m;
+	unsigned int t;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	m = timer1_overflow_count;
+	t = TCNT1;
+
+	// an overflow that happened since interrupts were disabled hasn't been
+	// counted yet; a small count means the wrap came before we read it.
+	if ((TIMER1_FLAG_REG & _BV(TOV1)) && (t < 0x8000))
+		m++;
+
+	SREG = oldSREG;
+
+	return ((unsigned long)m << 16) | t;
+}
@@ -40,14 +40,14 @@ void pinMode(uint8_t pin, uint8_t mode)
 
 	if (mode == INPUT) { 
 		uint8_t oldSREG = SREG;
-                cli();
+                CRITICAL_BEGIN(oldSREG);
 		*reg &= ~bit;
-		SREG = oldSREG;
+		CRITICAL_END(oldSREG);
 	} else {
 		uint8_t oldSREG = SREG;
-                cli();
+                CRITICAL_BEGIN(oldSREG);
 		*reg |= bit;
-		SREG = oldSREG;
+		CRITICAL_END(oldSREG);
 	}
 }
 
@@ -67,58 +67,17 @@ void pinMode(uint8_t pin, uint8_t mode)
 //static inline void turnOffPWM(uint8_t timer)
 static void turnOffPWM(uint8_t timer)
 {
-	switch (timer)
-	{
-		#if defined(TCCR1A) && defined(COM1A1)
-		case TIMER1A:   cbi(TCCR1A, COM1A1);    break;
-		#endif
-		#if defined(TCCR1A) && defined(COM1B1)
-		case TIMER1B:   cbi(TCCR1A, COM1B1);    break;
-		#endif
-		
-		#if defined(TCCR2) && defined(COM21)
-		case  TIMER2:   cbi(TCCR2, COM21);      break;
-		#endif
-		
-		#if defined(TCCR0A) && defined(COM0A1)
-		case  TIMER0A:  cbi(TCCR0A, COM0A1);    break;
-		#endif
-		
-		#if defined(TIMER0B) && defined(COM0B1)
-		case  TIMER0B:  cbi(TCCR0A, COM0B1);    break;
-		#endif
-		#if defined(TCCR2A) && defined(COM2A1)
-		case  TIMER2A:  cbi(TCCR2A, COM2A1);    break;
-		#endif
-		#if defined(TCCR2A) && defined(COM2B1)
-		case  TIMER2B:  cbi(TCCR2A, COM2B1);    break;
-		#endif
-		
-		#if defined(TCCR3A) && defined(COM3A1)
-		case  TIMER3A:  cbi(TCCR3A, COM3A1);    break;
-		#endif
-		#if defined(TCCR3A) && defined(COM3B1)
-		case  TIMER3B:  cbi(TCCR3A, COM3B1);    break;
-		#endif
-		#if defined(TCCR3A) && defined(COM3C1)
-		case  TIMER3C:  cbi(TCCR3A, COM3C1);    break;
-		#endif
-
-		#if defined(TCCR4A) && defined(COM4A1)
-		case  TIMER4A:  cbi(TCCR4A, COM4A1);    break;
-		#endif
-		#if defined(TCCR4A) && defined(COM4B1)
-		case  TIMER4B:  cbi(TCCR4A, COM4B1);    break;
-		#endif
-		#if defined(TCCR4A) && defined(COM4C1)
-		case  TIMER4C:  cbi(TCCR4A, COM4C1);    break;
-		#endif
-		#if defined(TCCR5A)
-		case  TIMER5A:  cbi(TCCR5A, COM5A1);    break;
-		case  TIMER5B:  cbi(TCCR5A, COM5B1);    break;
-		case  TIMER5C:  cbi(TCCR5A, COM5C1);    break;
-		#endif
-	}
+	volatile uint8_t *tccr = timerToControlRegister(timer);
+	uint8_t oldSREG;
+
+	if (tccr == 0) return;
+
+	oldSREG = SREG;
+	CRITICAL_BEGIN(oldSREG);
+	*tccr &= ~timerToCompareOutputMask(timer);
+	CRITICAL_END(oldSREG);
+
+	timerChannelRelease(timerToTimerNumber(timer), timerToChannel(timer), TIMER_OWNER_PWM);
 }
 
 void digitalWrite(uint8_t pin, uint8_t val)
@@ -138,14 +97,14 @@ void digitalWrite(uint8_t pin, uint8_t val)
 
 	if (val == LOW) {
 		uint8_t oldSREG = SREG;
-                cli();
+                CRITICAL_BEGIN(oldSREG);
 		*out &= ~bit;
-		SREG = oldSREG;
+		CRITICAL_END(oldSREG);
 	} else {
 		uint8_t oldSREG = SREG;
-                cli();
+                CRITICAL_BEGIN(oldSREG);
 		*out |= bit;
-		SREG = oldSREG;
+		CRITICAL_END(oldSREG);
 	}
 }
 
@@ -0,0 +1,149 @@
+/*
+  wiring_edge.c - timestamped edge capture on the external interrupt pins
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// The interrupt handler only records the pin level and a timestamp; the
+// decoding of pulse trains happens later in loop().  The queue has a single
+// producer (the handlers, which can't interrupt each other) and a single
+// consumer (edgeRead()), so head is only written by the handlers and tail
+// only by the reader.  Both are single bytes, which the AVR reads and
+// writes atomically, so neither side needs to disable interrupts.
+#if !defined(EDGE_BUFFER_SIZE)
+#if (RAMEND < 1000)
+  #define EDGE_BUFFER_SIZE 8
+#else
+  #define EDGE_BUFFER_SIZE 16
+#endif
+#endif
+
+#if (EDGE_BUFFER_SIZE & (EDGE_BUFFER_SIZE - 1))
+#error EDGE_BUFFER_SIZE must be a power of two
+#endif
+
+struct edge_source
+{
+	volatile uint8_t *pin;
+	uint8_t mask;
+	uint8_t interrupt;
+};
+
+struct edge_queue
+{
+	edge_event buffer[EDGE_BUFFER_SIZE];
+	uint8_t head;
+	uint8_t tail;
+	unsigned int overruns;
+};
+
+static struct edge_source edge_sources[EXTERNAL_NUM_INTERRUPTS];
+static volatile struct edge_queue edge_queue;
+
+// micros() by default; a sketch that has started the timer 1 cycle counter
+// can pass cycles to edgeCaptureClock().  going through a pointer keeps
+// wiring_cycles.o (and its claim on timer 1) out of sketches that don't.
+static unsigned long (*edge_clock)(void) = micros;
+
+static void edgeCaptureHandler(void *arg)
+{
+	struct edge_source *src = (struct edge_source *)arg;
+	uint8_t level = (*src->pin & src->mask) ? HIGH : LOW;
+	unsigned long t = edge_clock();
+	uint8_t head = edge_queue.head;
+	uint8_t next = (head + 1) & (EDGE_BUFFER_SIZE - 1);
+
+	// if the reader has fallen a whole buffer behind, drop the edge and
+	// count it rather than overwriting one it hasn't seen yet.
+	if (next == edge_queue.tail) {
+		edge_queue.overruns++;
+		return;
+	}
+
+	edge_queue.buffer[head].interrupt = src->interrupt;
+	edge_queue.buffer[head].level = level;
+	edge_queue.buffer[head].time = t;
+	edge_queue.head = next;
+}
+
+// edgeCaptureBegin(), with the slot wiring.h has found for the number
+uint8_t edgeCaptureAttach(volatile external_interrupt *slot, uint8_t interruptNum, int mode)
+{
+	uint8_t pin;
+
+	if (slot == 0 || interruptNum >= EXTERNAL_NUM_INTERRUPTS)
+		return 0;
+
+	pin = interruptToDigitalPin(interruptNum);
+	if (pin == NOT_A_PIN)
+		return 0;
+
+	edge_sources[interruptNum].pin = portInputRegister(digitalPinToPort(pin));
+	edge_sources[interruptNum].mask = digitalPinToBitMask(pin);
+	edge_sources[interruptNum].interrupt = interruptNum;
+
+	externalInterruptAttach(slot, interruptNum, 0, edgeCaptureHandler,
+		&edge_sources[interruptNum], mode);
+	return 1;
+}
+
+void edgeCaptureClock(unsigned long (*clock)(void))
+{
+	uint8_t oldSREG = SREG;
+
+	CRITICAL_BEGIN(oldSREG);
+	edge_clock = clock;
+	CRITICAL_END(oldSREG);
+}
+
+uint8_t edgeAvailable()
+{
+	return (uint8_t)(edge_queue.head - edge_queue.tail) & (EDGE_BUFFER_SIZE - 1);
+}
+
+uint8_t edgeRead(edge_event *event)
+{
+	uint8_t tail = edge_queue.tail;
+
+	if (tail == edge_queue.head)
+		return 0;
+
+	event->interrupt = edge_queue.buffer[tail].interrupt;
+	event->level = edge_queue.buffer[tail].level;
+	event->time = edge_queue.buffer[tail].time;
+
+	// only release the slot once it has been copied out
+	edge_queue.tail = (tail + 1) & (EDGE_BUFFER_SIZE - 1);
+	return 1;
+}
+
+unsigned int edgeOverruns()
+{
+	unsigned int n;
+	uint8_t oldSREG = SREG;
+
+	CRITICAL_BEGIN(oldSREG);
+	n = edge_queue.overruns;
+	CRITICAL_END(oldSREG);
+
+	return n;
+}
@@ -0,0 +1,303 @@
+/*
+  wiring_icp.c - pulse and frequency measurement with timer input capture
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+
+// Unlike pulseIn(), the edges are latched by the timer hardware into ICRn,
+// so the measurement is exact to one cpu cycle (62.5 ns at 16 MHz) no
+// matter how late the capture interrupt runs.  The timer runs in normal
+// mode with no prescaler and an overflow count extends it to 32 bits.
+// Timer 1 shares that count with cycles(); timers 3, 4 and 5 keep their
+// own.  A measurement takes over the timer, so pwm on its pins stops.
+//
+// The input capture pins are ICP1 on digital pin 8 of the ATmega168/328,
+// and ICP4/ICP5 on digital pins 49/48 of the Mega (ICP1 and ICP3 aren't
+// brought out there).
+
+#if defined(__AVR_ATmega8__)
+#define TIMSK1 TIMSK
+#define TIFR1 TIFR
+#define ICIE1 TICIE1
+#endif
+
+#define CAPTURE_IDLE 0
+#define CAPTURE_WAIT_FIRST 1	// waiting for the rising edge that starts period 1
+#define CAPTURE_WAIT_FALL 2	// inside a high phase
+#define CAPTURE_WAIT_RISE 3	// inside a low phase
+#define CAPTURE_DONE 4
+
+struct pulse_capture
+{
+	uint8_t state;
+	uint8_t periods;
+	uint8_t count;
+	unsigned long rise;
+	unsigned long periodSum;
+	unsigned long highSum;
+};
+
+extern volatile unsigned int timer1_overflow_count;
+
+static volatile struct pulse_capture capture1;
+#if defined(ICR3)
+static volatile struct pulse_capture capture3;
+static volatile unsigned int timer3_overflow_count;
+#endif
+#if defined(ICR4)
+static volatile struct pulse_capture capture4;
+static volatile unsigned int timer4_overflow_count;
+#endif
+#if defined(ICR5)
+static volatile struct pulse_capture capture5;
+static volatile unsigned int timer5_overflow_count;
+#endif
+
+// feeds one captured edge to the measurement; returns 1 once all the
+// requested periods have been seen and the capture interrupt can go off.
+static inline uint8_t pulseCaptureEdge(volatile struct pulse_capture *pc,
+	unsigned long t)
+{
+	switch (pc->state) {
+	case CAPTURE_WAIT_FIRST:
+		pc->rise = t;
+		pc->state = CAPTURE_WAIT_FALL;
+		break;
+	case CAPTURE_WAIT_FALL:
+		pc->highSum += t - pc->rise;
+		pc->state = CAPTURE_WAIT_RISE;
+		break;
+	case CAPTURE_WAIT_RISE:
+		pc->periodSum += t - pc->rise;
+		pc->rise = t;
+		if (++pc->count == pc->periods) {
+			pc->state = CAPTURE_DONE;
+			return 1;
+		}
+		pc->state = CAPTURE_WAIT_FALL;
+		break;
+	}
+	return 0;
+}
+
+// every edge flips the edge select bit, which can itself set ICFn, so the
+// flag is cleared afterwards.  an overflow still pending when the capture
+// happened belongs to this timestamp only if ICRn wrapped before it.
+#define PULSE_CAPTURE_HANDLERS(n, overflows) \
+SIGNAL(TIMER##n##_CAPT_vect) \
+{ \
+	unsigned int icr = ICR##n; \
+	unsigned int hi = overflows; \
+	if ((TIFR##n & _BV(TOV##n)) && (icr < 0x8000)) \
+		hi++; \
+	if (pulseCaptureEdge(&capture##n, ((unsigned long)hi << 16) | icr)) \
+		cbi(TIMSK##n, ICIE##n); \
+	TCCR##n##B ^= _BV(ICES##n); \
+	TIFR##n = _BV(ICF##n); \
+}
+
+PULSE_CAPTURE_HANDLERS(1, timer1_overflow_count)
+
+#if defined(ICR3)
+PULSE_CAPTURE_HANDLERS(3, timer3_overflow_count)
+SIGNAL(TIMER3_OVF_vect) { timer3_overflow_count++; }
+#endif
+#if defined(ICR4)
+PULSE_CAPTURE_HANDLERS(4, timer4_overflow_count)
+SIGNAL(TIMER4_OVF_vect) { timer4_overflow_count++; }
+#endif
+#if defined(ICR5)
+PULSE_CAPTURE_HANDLERS(5, timer5_overflow_count)
+SIGNAL(TIMER5_OVF_vect) { timer5_overflow_count++; }
+#endif
+
+static volatile struct pulse_capture *pulseCaptureSlot(uint8_t timer)
+{
+	switch (timer) {
+	case 1: return &capture1;
+#if defined(ICR3)
+	case 3: return &capture3;
+#endif
+#if defined(ICR4)
+	case 4: return &capture4;
+#endif
+#if defined(ICR5)
+	case 5: return &capture5;
+#endif
+	}
+	return 0;
+}
+
+// Starts measuring the given number of full periods (rising edge to rising
+// edge) of the signal on the input capture pin of timer 1, 3, 4 or 5.
+// Returns 0 if the timer has no input capture unit or is in use; timer 1
+// is shared with cycles(), which it starts.
+uint8_t pulseCaptureStart(uint8_t timer, uint8_t periods)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+	uint8_t oldSREG = SREG;
+
+	if (pc == 0 || periods == 0)
+		return 0;
+	if (timer == 1 ? !cyclesBegin() : !timerAcquire(timer, TIMER_OWNER_CAPTURE))
+		return 0;
+
+	cli();
+	pc->state = CAPTURE_WAIT_FIRST;
+	pc->periods = periods;
+	pc->count = 0;
+	pc->periodSum = 0;
+	pc->highSum = 0;
+
+	// normal mode, no prescaler, capture on the rising edge
+	switch (timer) {
+	case 1:
+		TCCR1B = _BV(ICES1) | _BV(CS10);
+		TIFR1 = _BV(ICF1);
+		sbi(TIMSK1, ICIE1);
+		break;
+#if defined(ICR3)
+	case 3:
+		TCCR3A = 0;
+		TCCR3B = _BV(ICES3) | _BV(CS30);
+		timer3_overflow_count = 0;
+		TIFR3 = _BV(ICF3) | _BV(TOV3);
+		TIMSK3 |= _BV(ICIE3) | _BV(TOIE3);
+		break;
+#endif
+#if defined(ICR4)
+	case 4:
+		TCCR4A = 0;
+		TCCR4B = _BV(ICES4) | _BV(CS40);
+		timer4_overflow_count = 0;
+		TIFR4 = _BV(ICF4) | _BV(TOV4);
+		TIMSK4 |= _BV(ICIE4) | _BV(TOIE4);
+		break;
+#endif
+#if defined(ICR5)
+	case 5:
+		TCCR5A = 0;
+		TCCR5B = _BV(ICES5) | _BV(CS50);
+		timer5_overflow_count = 0;
+		TIFR5 = _BV(ICF5) | _BV(TOV5);
+		TIMSK5 |= _BV(ICIE5) | _BV(TOIE5);
+		break;
+#endif
+	}
+	SREG = oldSREG;
+
+	return 1;
+}
+
+uint8_t pulseCaptureReady(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	return pc != 0 && pc->state == CAPTURE_DONE;
+}
+
+// Abandons a measurement.  Timers 3-5 go back to the pwm setup from
+// init(); timer 1 keeps counting cycles until cyclesEnd() is called, since
+// something else may be using cycles().
+void pulseCaptureStop(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	if (pc == 0)
+		return;
+	if (timer != 1 && timerOwner(timer) != TIMER_OWNER_CAPTURE)
+		return;
+
+	switch (timer) {
+	case 1:
+		cbi(TIMSK1, ICIE1);
+		break;
+#if defined(ICR3)
+	case 3:
+		TIMSK3 &= ~(_BV(ICIE3) | _BV(TOIE3));
+		TCCR3B = _BV(CS31) | _BV(CS30);
+		TCCR3A = _BV(WGM30);
+		pwm_top[3] = 255;
+		break;
+#endif
+#if defined(ICR4)
+	case 4:
+		TIMSK4 &= ~(_BV(ICIE4) | _BV(TOIE4));
+		TCCR4B = _BV(CS41) | _BV(CS40);
+		TCCR4A = _BV(WGM40);
+		pwm_top[4] = 255;
+		break;
+#endif
+#if defined(ICR5)
+	case 5:
+		TIMSK5 &= ~(_BV(ICIE5) | _BV(TOIE5));
+		TCCR5B = _BV(CS51) | _BV(CS50);
+		TCCR5A = _BV(WGM50);
+		pwm_top[5] = 255;
+		break;
+#endif
+	}
+	pc->state = CAPTURE_IDLE;
+	timerRelease(timer, TIMER_OWNER_CAPTURE);
+}
+
+// The results below are averages over the periods asked for in
+// pulseCaptureStart(), and are 0 until pulseCaptureReady() says so.
+
+// period in cpu cycles
+unsigned long pulseCapturePeriod(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	if (pc == 0 || pc->state != CAPTURE_DONE)
+		return 0;
+	return pc->periodSum / pc->periods;
+}
+
+// length of the high phase in cpu cycles
+unsigned long pulseCaptureHigh(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	if (pc == 0 || pc->state != CAPTURE_DONE)
+		return 0;
+	return pc->highSum / pc->periods;
+}
+
+// frequency in hertz
+double pulseCaptureFrequency(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	if (pc == 0 || pc->state != CAPTURE_DONE || pc->periodSum == 0)
+		return 0;
+	return (double)F_CPU * pc->periods / pc->periodSum;
+}
+
+// fraction of each period spent high, 0.0 to 1.0
+double pulseCaptureDuty(uint8_t timer)
+{
+	volatile struct pulse_capture *pc = pulseCaptureSlot(timer);
+
+	if (pc == 0 || pc->state != CAPTURE_DONE || pc->periodSum == 0)
+		return 0;
+	return (double)pc->highSum / pc->periodSum;
+}
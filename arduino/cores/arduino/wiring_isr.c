@@ -0,0 +1,127 @@
+/*
+  wiring_isr.c - interrupt time accounting
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include <string.h>
+
+#include "wiring_private.h"
+
+#if defined(ISR_ACCOUNTING)
+
+// see wiring_isr.h.  The sections here use plain cli(), so the
+// accounting doesn't time itself.
+
+isr_stat isr_stats[ISR_IDS];
+unsigned int isr_critical_start;
+static unsigned int isr_critical_max;
+static PGM_P isr_critical_where;
+
+// Starts cycles(), which the times are read from, and zeroes everything.
+// Returns 0 if timer 1 is in use for something else (see timerAcquire()).
+uint8_t isrAccountingBegin()
+{
+	if (!cyclesBegin())
+		return 0;
+	isrAccountingReset();
+	return 1;
+}
+
+void isrAccountingReset()
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	memset(isr_stats, 0, sizeof(isr_stats));
+	isr_critical_max = 0;
+	isr_critical_where = 0;
+	SREG = oldSREG;
+}
+
+// Copies slot id, consistently even while its handler is running.
+// Returns 0 for an id past the last.
+uint8_t isrRead(uint8_t id, isr_stat *copy)
+{
+	uint8_t oldSREG = SREG;
+
+	if (id >= ISR_IDS)
+		return 0;
+	cli();
+	*copy = isr_stats[id];
+	SREG = oldSREG;
+	return 1;
+}
+
+// The longest stretch with interrupts off, in cycles.
+unsigned int isrCriticalMax()
+{
+	unsigned int t;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	t = isr_critical_max;
+	SREG = oldSREG;
+	return t;
+}
+
+// Where that stretch ended, as "file:line" in program memory, or 0 if
+// none has been timed.
+PGM_P isrCriticalWhere()
+{
+	PGM_P p;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	p = isr_critical_where;
+	SREG = oldSREG;
+	return p;
+}
+
+// The longest an interrupt has had to wait, as far as the accounting can
+// tell: the longest critical section or the longest handler, whichever is
+// more.  Leaves out the handlers' entry and exit, and anything that
+// turned interrupts off without CRITICAL_BEGIN().
+unsigned int isrLatencyMax()
+{
+	isr_stat s;
+	unsigned int t = isrCriticalMax();
+	uint8_t id;
+
+	for (id = 0; isrRead(id, &s); id++)
+		if (s.max > t)
+			t = s.max;
+	return t;
+}
+
+// from CRITICAL_END(), with interrupts back on
+void isrCriticalNote(unsigned int t, PGM_P where)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	if (t > isr_critical_max) {
+		isr_critical_max = t;
+		isr_critical_where = where;
+	}
+	SREG = oldSREG;
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+  wiring_isr.h - interrupt time accounting
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef WiringIsr_h
+#define WiringIsr_h
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// ISR_ACCOUNT(id) at the top of an interrupt handler counts the handler's
+// runs and the cpu cycles spent in them, in slot id, and keeps the longest
+// run.  The core's own handlers for timer 0 overflow (millis()), serial
+// receive and attachInterrupt() have slots of their own; a sketch's
+// handlers can use ISR_ID_USER + 0 to ISR_USER_IDS - 1.
+//
+// CRITICAL_BEGIN(oldSREG) and CRITICAL_END(oldSREG) stand for the core's
+// "cli(); ... SREG = oldSREG;" and time each stretch with interrupts off,
+// keeping the longest and where it ended.  Stretches inside an interrupt
+// handler, or anywhere interrupts were already off, are part of something
+// longer and aren't timed on their own.  The longer of that and the
+// longest handler is how long an interrupt can be kept waiting.
+//
+// Build with ISR_ACCOUNTING defined (ISR_ACCOUNTING = 1 in the sketch's
+// Makefile) for any of this; otherwise the macros are plain cli() and
+// SREG writes and the functions do nothing.  isrAccountingBegin() starts
+// cycles() (see wiring_cycles.c), since the times are read from TCNT1 and
+// mean nothing unless timer 1 is counting cpu cycles.  The times leave out
+// the 4 cycles the cpu takes to enter a handler, the handler's register
+// saves and restores, and the reti: add 20 to 50 cycles for a typical
+// handler, more for one that calls a function.  Anything over 65535
+// cycles (4 ms at 16 MHz) wraps.  Accounting adds about 40 cycles to each
+// handler, and 10 or so to each critical section, plus the string
+// naming its place in flash.
+#define ISR_ID_TIMER0_OVF 0
+#define ISR_ID_SERIAL0 1
+#define ISR_ID_SERIAL1 2
+#define ISR_ID_SERIAL2 3
+#define ISR_ID_SERIAL3 4
+// ISR_ID_INT0 + n for the handler given to attachInterrupt(n, ...)
+#define ISR_ID_INT0 5
+
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define ISR_ID_USER (ISR_ID_INT0 + 8)
+#else
+#define ISR_ID_USER (ISR_ID_INT0 + 2)
+#endif
+
+#if !defined(ISR_USER_IDS)
+#define ISR_USER_IDS 4
+#endif
+
+#define ISR_IDS (ISR_ID_USER + ISR_USER_IDS)
+
+typedef struct {
+	unsigned long count;
+	unsigned long cycles;
+	unsigned int max;
+} isr_stat;
+
+#if defined(ISR_ACCOUNTING)
+
+typedef struct {
+	uint8_t id;
+	unsigned int start;
+} isr_account;
+
+extern isr_stat isr_stats[ISR_IDS];
+extern unsigned int isr_critical_start;
+
+// inlined into the handler, so it doesn't force the handler to save every
+// register the way a call would; id is a constant, so the slot's address
+// is too
+static inline void isrAccountExit(isr_account *a) __attribute__ ((always_inline));
+static inline void isrAccountExit(isr_account *a)
+{
+	unsigned int t = TCNT1 - a->start;
+	isr_stat *s = &isr_stats[a->id];
+
+	s->count++;
+	s->cycles += t;
+	if (t > s->max)
+		s->max = t;
+}
+
+#define ISR_CAT(a, b) a##b
+#define ISR_NAME(a, b) ISR_CAT(a, b)
+#define ISR_STR2(x) #x
+#define ISR_STR(x) ISR_STR2(x)
+
+#define ISR_ACCOUNT(id) \
+	isr_account ISR_NAME(isr_account_, __LINE__) \
+		__attribute__ ((cleanup(isrAccountExit))) = { (id), TCNT1 }
+
+#define CRITICAL_BEGIN(sreg) do { \
+	cli(); \
+	if ((sreg) & _BV(SREG_I)) \
+		isr_critical_start = TCNT1; \
+} while (0)
+
+// the time is read before interrupts go back on, and noted after
+#define CRITICAL_END(sreg) do { \
+	if ((sreg) & _BV(SREG_I)) { \
+		unsigned int isr_critical_time = TCNT1 - isr_critical_start; \
+		SREG = (sreg); \
+		isrCriticalNote(isr_critical_time, PSTR(__FILE__ ":" ISR_STR(__LINE__))); \
+	} else { \
+		SREG = (sreg); \
+	} \
+} while (0)
+
+uint8_t isrAccountingBegin(void);
+void isrAccountingReset(void);
+uint8_t isrRead(uint8_t id, isr_stat *copy);
+unsigned int isrCriticalMax(void);
+PGM_P isrCriticalWhere(void);
+unsigned int isrLatencyMax(void);
+void isrCriticalNote(unsigned int t, PGM_P where);
+
+#else
+
+#define ISR_ACCOUNT(id) do { } while (0)
+#define CRITICAL_BEGIN(sreg) cli()
+#define CRITICAL_END(sreg) (SREG = (sreg))
+
+static inline uint8_t isrAccountingBegin(void) { return 1; }
+static inline void isrAccountingReset(void) { }
+static inline uint8_t isrRead(uint8_t id, isr_stat *copy) { (void) id; (void) copy; return 0; }
+static inline unsigned int isrCriticalMax(void) { return 0; }
+static inline PGM_P isrCriticalWhere(void) { return 0; }
+static inline unsigned int isrLatencyMax(void) { return 0; }
+
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+
+class Print;
+#if defined(ISR_ACCOUNTING)
+void isrDump(Print &out);
+#else
+inline void isrDump(Print &) { }
+#endif
+#endif
+
+#endif
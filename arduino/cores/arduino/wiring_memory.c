@@ -0,0 +1,211 @@
+/*
+  wiring_memory.c - stack and heap watermarks
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+#include "wiring_memory.h"
+
+// At startup, before the constructors run, everything from the start of
+// the heap to the stack is painted with MEMORY_CANARY.  The heap grows up
+// from __heap_start to __brkval, where malloc() has got to, and the stack
+// down from RAMEND; the deepest the stack has been is the lowest byte
+// above the heap that's been written over.  The heap's highest point is
+// kept by noting __brkval whenever one of the functions below runs, so a
+// peak that comes and goes in between is missed, though main() notes it
+// after every pass of loop() too.  A stack frame that leaves some of its
+// bytes unwritten, or writes the canary, can make stackHighWater() short
+// by those bytes.
+
+extern char *__brkval;
+
+#if defined(ARDUINO_HOST)
+// The host build (see arduino/host) has no AVR data space to look at;
+// SP and the heap are offsets into a stand-in for it that a test moves
+// about as a sketch's stack and malloc() would.
+#define memoryAt(a) ((char *) __host_ram + (a))
+#define memoryHeapStart() memoryAt(HOST_HEAP_START)
+#else
+extern char __heap_start;
+
+#define memoryAt(a) ((char *) (a))
+#define memoryHeapStart() (&__heap_start)
+#endif
+
+static char *memory_heap_max;
+static uint8_t *memory_stack_min;
+static void (*memory_watch_fn)(void);
+
+// naked and in .init3, after the stack pointer and r1 are set up and
+// before .data and .bss are: it's run in line, not called, and touches
+// no stack of its own
+#if !defined(ARDUINO_HOST)
+void memoryPaint(void) __attribute__ ((naked, used, section (".init3")));
+#endif
+void memoryPaint(void)
+{
+	uint8_t *p = (uint8_t *) memoryHeapStart();
+
+	while (p < (uint8_t *) memoryAt(SP))
+		*p++ = MEMORY_CANARY;
+}
+
+static char *memoryHeapTop()
+{
+	return __brkval ? __brkval : memoryHeapStart();
+}
+
+// notes the heap's current top, and returns the highest it's been
+static char *memoryHeapMax()
+{
+	char *heap = memoryHeapTop();
+	uint8_t oldSREG = SREG;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (heap > memory_heap_max)
+		memory_heap_max = heap;
+	heap = memory_heap_max;
+	CRITICAL_END(oldSREG);
+
+	return heap;
+}
+
+// The bytes between the top of the heap and the stack right now.  Blocks
+// that have been freed below the top aren't counted; malloc() can reuse
+// them, but only for requests that fit.
+int freeMemory()
+{
+	return memoryAt(SP) - memoryHeapTop();
+}
+
+// The most stack there's been, in bytes, interrupt handlers included.
+// Scans the painted gap, so it takes about 4 cycles a byte.
+unsigned int stackHighWater()
+{
+	uint8_t *p = (uint8_t *) memoryHeapMax();
+	uint8_t *sp = (uint8_t *) memoryAt(SP);
+
+	while (p < sp && *p == MEMORY_CANARY)
+		p++;
+	if (p == sp)
+		return (uint8_t *) memoryAt(RAMEND) - sp;
+	return (uint8_t *) memoryAt(RAMEND + 1) - p;
+}
+
+// The most heap there's been, in bytes, as far as has been seen.
+unsigned int heapHighWater()
+{
+	return memoryHeapMax() - memoryHeapStart();
+}
+
+// Called by main() after each pass of loop(): notes the heap's top for
+// the watch's interrupt handler.  __brkval is 16 bits that malloc()
+// writes a byte at a time, so the handler can't read it itself; an
+// interrupt in between would see half of each, and reading it twice
+// wouldn't help, since malloc() can't finish until the handler returns.
+void memoryWatchRun()
+{
+	memoryHeapMax();
+}
+
+#if defined(TIMSK0) && defined(OCIE0B)
+
+// Once per timer 0 period, at compare match B: trips if the stack has
+// come within MEMORY_GUARD bytes of the heap's highest point, as last
+// noted from the main line.  The stack's lowest point is the lowest SP
+// seen here, followed further down while the bytes below it have lost
+// their canary: that catches a deeper call made and returned from in
+// between.  Nothing is looked at below the heap's noted top plus the
+// guard, since malloc() may have handed those bytes out since.  About
+// 100 cycles each time, 0.6% of the CPU at 16 MHz, plus 6 or so for each
+// byte the stack has gone deeper, once.
+SIGNAL(TIMER0_COMPB_vect)
+{
+	uint8_t *sp = (uint8_t *) memoryAt(SP);
+	uint8_t *heap = (uint8_t *) memory_heap_max;
+
+	if (sp < memory_stack_min)
+		memory_stack_min = sp;
+	while (memory_stack_min - heap >= MEMORY_GUARD &&
+	       (memory_stack_min[0] != MEMORY_CANARY || memory_stack_min[-1] != MEMORY_CANARY))
+		memory_stack_min--;
+
+	if (memory_stack_min - heap >= MEMORY_GUARD)
+		return;
+
+	// once only; the channel stays claimed until memoryWatchEnd()
+	TIMSK0 &= ~_BV(OCIE0B);
+	memory_watch_fn();
+}
+
+// Checks the stack against the heap about once a millisecond, from an
+// interrupt on timer 0's compare channel B, which takes the channel (pin
+// 5 on the ATmega168/328, 4 on the Mega) away from analogWrite().  When
+// the stack comes too close, fn is called, once, from the interrupt
+// handler with interrupts off: it should put the outputs somewhere safe
+// and then stop or reset, since the program is about to corrupt its own
+// memory.  Returns 0 if the channel is in use.
+uint8_t memoryWatch(void (*fn)(void))
+{
+	uint8_t oldSREG = SREG;
+
+	if (fn == 0 || !timerChannelAcquire(0, TIMER_CHANNEL_B, TIMER_OWNER_MEMORY))
+		return 0;
+
+	memoryHeapMax();
+	CRITICAL_BEGIN(oldSREG);
+	memory_watch_fn = fn;
+	memory_stack_min = (uint8_t *) memoryAt(SP);
+	// half a period from the overflow, out of millis()'s way
+	OCR0B = 128;
+	TIFR0 = _BV(OCF0B);
+	TIMSK0 |= _BV(OCIE0B);
+	CRITICAL_END(oldSREG);
+
+	return 1;
+}
+
+void memoryWatchEnd()
+{
+	uint8_t oldSREG = SREG;
+
+	if (timerChannelOwner(0, TIMER_CHANNEL_B) != TIMER_OWNER_MEMORY)
+		return;
+
+	CRITICAL_BEGIN(oldSREG);
+	TIMSK0 &= ~_BV(OCIE0B);
+	CRITICAL_END(oldSREG);
+	timerChannelRelease(0, TIMER_CHANNEL_B, TIMER_OWNER_MEMORY);
+}
+
+#else
+
+// no compare channel B on timer 0 (the ATmega8)
+uint8_t memoryWatch(void (*fn)(void))
+{
+	return 0;
+}
+
+void memoryWatchEnd()
+{
+}
+
+#endif
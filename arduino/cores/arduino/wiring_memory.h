@@ -0,0 +1,52 @@
+/*
+  wiring_memory.h - stack and heap watermarks
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef WiringMemory_h
+#define WiringMemory_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// the byte the free RAM is painted with at startup
+#define MEMORY_CANARY 0xC5
+
+// how close memoryWatch() lets the stack come to the heap, in bytes; the
+// callback needs room to run in, besides the interrupt's own 20 or so
+#if !defined(MEMORY_GUARD)
+#define MEMORY_GUARD 48
+#endif
+
+int freeMemory(void);
+unsigned int stackHighWater(void);
+unsigned int heapHighWater(void);
+uint8_t memoryWatch(void (*fn)(void));
+void memoryWatchEnd(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
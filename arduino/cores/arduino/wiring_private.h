@@ -32,6 +32,7 @@
 #include <stdarg.h>
 
 #include "wiring.h"
+#include "wiring_isr.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -60,6 +61,87 @@ extern "C"{
 #endif
 
 typedef void (*voidFuncPtr)(void);
+typedef void (*voidFuncPtrArg)(void *);
+
+// the whole of WInterruptsN.c: interrupt number n's slot, and the handler
+// on its vector that calls whatever attachInterrupt() put there
+#define EXTERNAL_INTERRUPT_DISPATCH(n) \
+volatile external_interrupt external_interrupt_##n; \
+\
+SIGNAL(EXTERNAL_INT_##n##_vect) \
+{ \
+	ISR_ACCOUNT(ISR_ID_INT0 + n); \
+	if (external_interrupt_##n.funcArg) \
+		external_interrupt_##n.funcArg(external_interrupt_##n.arg); \
+	else if (external_interrupt_##n.func) \
+		external_interrupt_##n.func(); \
+}
+
+// ADPS2:0 for the ADC clock.  Full 10-bit accuracy wants 50-200 kHz, so
+// take the smallest division that gets under 200 kHz.  analogReadFast()
+// trades accuracy for speed with a clock of about 1 MHz (at most 1.25).
+#if F_CPU >= 12800000L
+#define ADC_PRESCALE 7		// 128
+#elif F_CPU >= 6400000L
+#define ADC_PRESCALE 6		// 64
+#elif F_CPU >= 3200000L
+#define ADC_PRESCALE 5		// 32
+#elif F_CPU >= 1600000L
+#define ADC_PRESCALE 4		// 16
+#elif F_CPU >= 800000L
+#define ADC_PRESCALE 3		// 8
+#elif F_CPU >= 400000L
+#define ADC_PRESCALE 2		// 4
+#else
+#define ADC_PRESCALE 1		// 2
+#endif
+
+#if F_CPU > 10000000L
+#define ADC_FAST_PRESCALE 4	// 16
+#elif F_CPU > 5000000L
+#define ADC_FAST_PRESCALE 3	// 8
+#elif F_CPU > 2500000L
+#define ADC_FAST_PRESCALE 2	// 4
+#else
+#define ADC_FAST_PRESCALE 1	// 2
+#endif
+
+// analog input pin or channel number to ADC channel
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define analogInputToChannel(P) ((P) >= 54 ? (P) - 54 : (P))
+#else
+#define analogInputToChannel(P) ((P) >= 14 ? (P) - 14 : (P))
+#endif
+
+// who has the ADC.  analogRead() claims it for one conversion, waiting
+// out an asynchronous one; the interrupt driven modes in wiring_adc.c
+// claim it for as long as they run.
+#define ADC_OWNER_NONE 0
+#define ADC_OWNER_SCAN 1
+#define ADC_OWNER_STREAM 2
+#define ADC_OWNER_READ 3
+#define ADC_OWNER_ASYNC 4
+#define ADC_OWNER_OVERSAMPLE 5
+
+extern uint8_t analog_reference;
+extern volatile uint8_t adc_owner;
+
+uint8_t adcAcquire(uint8_t owner);
+
+// who has the SPI unit.  wiring_spi.c holds it while its queue has
+// anything in it; the buffered shifts in wiring_shift.c take it for one
+// transfer and bit-bang instead if they can't get it.
+#define SPI_OWNER_NONE 0
+#define SPI_OWNER_QUEUE 1
+#define SPI_OWNER_SHIFT 2
+
+extern volatile uint8_t spi_owner;
+
+uint8_t spiAcquire(uint8_t owner);
+
+extern unsigned int pwm_top[];
+
+void timer0Advance(unsigned long n);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,135 @@
+/*
+  wiring_profile.c - cycle counting probes
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+#include "wiring_profile.h"
+
+#if defined(PROFILE)
+
+// Probes join the list the first time they're left, newest first.  The
+// list ends at profile_end rather than 0, so a probe's next pointer is
+// only 0 while it isn't on it.
+static profile_probe profile_end;
+static profile_probe *profile_probes = &profile_end;
+static unsigned long profile_overhead;
+
+// Starts cycles() and calibrates the probes.  Returns 0 if timer 1 is in
+// use, in which case the probes count nothing useful.
+uint8_t profileBegin()
+{
+	profile_probe empty = { 0, 0, 0, 0, 0xFFFFFFFFUL, 0 };
+	uint8_t i;
+
+	if (!cyclesBegin())
+		return 0;
+
+	// the quickest of a few empty scopes, with interrupts as they are;
+	// pointing it at itself keeps it off the list
+	empty.next = &empty;
+	profile_overhead = 0;
+	for (i = 0; i < 8; i++) {
+		profile_scope s = profileEnter(&empty);
+		profileExit(&s);
+	}
+	profile_overhead = empty.min;
+
+	return 1;
+}
+
+// Zeroes every probe.
+void profileReset()
+{
+	profile_probe *p;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	for (p = profile_probes; p != &profile_end; p = p->next) {
+		p->count = 0;
+		p->total = 0;
+		p->min = 0xFFFFFFFFUL;
+		p->max = 0;
+	}
+	SREG = oldSREG;
+}
+
+// Copies a probe, consistently even if it's in use from an interrupt.
+// Probes are numbered from 0 in the order they first ran, so a new one
+// doesn't move the others.  Returns 0 past the last one.
+uint8_t profileRead(uint8_t index, profile_probe *copy)
+{
+	profile_probe *p;
+	uint8_t n = 0;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	for (p = profile_probes; p != &profile_end; p = p->next)
+		n++;
+	if (index < n) {
+		for (p = profile_probes; ++index < n; p = p->next)
+			;
+		*copy = *p;
+	}
+	SREG = oldSREG;
+
+	return p != &profile_end;
+}
+
+// The cycles taken off each reading for the probe itself.
+unsigned long profileOverhead()
+{
+	return profile_overhead;
+}
+
+profile_scope profileEnter(profile_probe *probe)
+{
+	profile_scope s;
+
+	s.probe = probe;
+	s.start = cycles();
+	return s;
+}
+
+void profileExit(profile_scope *scope)
+{
+	unsigned long t = cycles() - scope->start;
+	profile_probe *p = scope->probe;
+	uint8_t oldSREG;
+
+	t = (t > profile_overhead) ? t - profile_overhead : 0;
+
+	oldSREG = SREG;
+	cli();
+	if (p->next == 0) {
+		p->next = profile_probes;
+		profile_probes = p;
+	}
+	p->count++;
+	p->total += t;
+	if (t < p->min)
+		p->min = t;
+	if (t > p->max)
+		p->max = t;
+	SREG = oldSREG;
+}
+
+#endif
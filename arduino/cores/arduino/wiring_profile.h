@@ -0,0 +1,124 @@
+/*
+  wiring_profile.h - cycle counting probes
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef WiringProfile_h
+#define WiringProfile_h
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// profileDump() formats
+#define PROFILE_TEXT 0
+#define PROFILE_BINARY 1
+
+// PROFILE_SCOPE("name") at the top of a block times every pass through
+// the rest of it in cpu cycles, from cycles() on timer 1, and adds the
+// time to a probe of that name: how many passes, their total, the
+// shortest and the longest.  A scope is exited however the block is left,
+// return and break included.  Each use makes a probe of its own, so a name
+// given twice shows up twice.  Build with PROFILE defined (PROFILE = 1 in
+// the sketch's Makefile) to have the probes compiled in; otherwise they
+// and the functions below are nothing, and cost nothing.
+//
+// profileBegin() starts cycles() and measures what a probe costs on its
+// own, which is taken off every reading; the probe itself is about 150
+// cycles in all, spent partly inside and partly outside its own
+// measurement.  Times are exact below 2^32 cycles, 268 seconds at 16 MHz.
+typedef struct profile_probe {
+	struct profile_probe *next;
+	const char *name;	// in program memory
+	unsigned long count;
+	unsigned long total;
+	unsigned long min;
+	unsigned long max;
+} profile_probe;
+
+typedef struct {
+	profile_probe *probe;
+	unsigned long start;
+} profile_scope;
+
+#if defined(PROFILE)
+
+#define PROFILE_CAT(a, b) a##b
+#define PROFILE_NAME(a, b) PROFILE_CAT(a, b)
+
+#define PROFILE_SCOPE(name) \
+	static const char PROFILE_NAME(profile_name_, __LINE__)[] PROGMEM = name; \
+	static profile_probe PROFILE_NAME(profile_probe_, __LINE__) = \
+		{ 0, PROFILE_NAME(profile_name_, __LINE__), 0, 0, 0xFFFFFFFFUL, 0 }; \
+	profile_scope PROFILE_NAME(profile_scope_, __LINE__) \
+		__attribute__ ((cleanup(profileExit))) = \
+		profileEnter(&PROFILE_NAME(profile_probe_, __LINE__))
+
+uint8_t profileBegin(void);
+void profileReset(void);
+uint8_t profileRead(uint8_t index, profile_probe *copy);
+unsigned long profileOverhead(void);
+profile_scope profileEnter(profile_probe *probe);
+void profileExit(profile_scope *scope);
+
+#else
+
+#define PROFILE_SCOPE(name) do { } while (0)
+
+static inline uint8_t profileBegin(void) { return 1; }
+static inline void profileReset(void) { }
+static inline uint8_t profileRead(uint8_t index, profile_probe *copy) { (void) index; (void) copy; return 0; }
+static inline unsigned long profileOverhead(void) { return 0; }
+
+#endif
+
+// the sampling profiler, in wiring_sampler.c
+#if !defined(SAMPLER_BINS)
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SAMPLER_BINS 256
+#else
+#define SAMPLER_BINS 64
+#endif
+#endif
+
+uint8_t samplerBegin(unsigned long from, unsigned long to);
+void samplerEnd(void);
+void samplerReset(void);
+unsigned int samplerCount(unsigned int bin);
+unsigned long samplerBase(void);
+unsigned long samplerBinSize(void);
+
+#ifdef __cplusplus
+} // extern "C"
+
+class Print;
+void samplerDump(Print &out);
+#if defined(PROFILE)
+void profileDump(Print &out, uint8_t format = PROFILE_TEXT);
+#else
+inline void profileDump(Print &, uint8_t = PROFILE_TEXT) { }
+#endif
+#endif
+
+#endif
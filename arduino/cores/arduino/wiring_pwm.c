@@ -0,0 +1,180 @@
+/*
+  wiring_pwm.c - pwm frequency and resolution
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+#if defined(TCCR2A)
+
+// These work on the timer behind a pwm pin, so they change every pin on
+// that timer: 9 and 10 share timer 1 on the ATmega168/328, for instance.
+// Timer 0 can't be changed, since millis() and delay() count its
+// overflows.  Set the duty again after changing a timer; the compare
+// registers are left as they were.
+//
+// The registers of each timer are found from the TCCRnA address in
+// timer_channel_PGM: TCCRnB is the next byte up, and on the 16-bit
+// timers TCNTn and ICRn are 4 and 6 bytes up.  The control bits sit at
+// the same positions in every timer of the same width, so timer 1's and
+// timer 2's names stand in for the others.
+
+static uint8_t pwmTimer(uint8_t pin, volatile uint8_t **tccr)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	uint8_t n;
+
+	if (timer == NOT_ON_TIMER)
+		return 0xFF;
+	*tccr = timerToControlRegister(timer);
+	if (*tccr == 0)
+		return 0xFF;
+	// a timer tone() or the like has taken is theirs until released
+	n = timerToTimerNumber(timer);
+	if (timerOwner(n) != TIMER_OWNER_PWM && timerOwner(n) != TIMER_OWNER_MILLIS)
+		return 0xFF;
+	return n;
+}
+
+// prescaler shifts for CS = 1, 2, ...
+static const uint8_t shift16[] = { 0, 3, 6, 8, 10 };
+static const uint8_t shift8[] = { 0, 3, 5, 6, 7, 8, 10 };
+
+// Runs the timer behind a pwm pin at the given frequency in PWM_FAST or
+// PWM_PHASE_CORRECT mode.  The 16-bit timers (1, and 3-5 on the Mega) get
+// the exact period from ICRn, with as many steps as the frequency allows:
+// 800 at 20 kHz and 16 MHz in fast mode, so pwmWrite() takes 0-800.  Timer
+// 2 stays 8-bit and only has its prescaler to play with, so it gets the
+// nearest of a handful of frequencies.  Returns the frequency actually
+// set, or 0 if the pin has no pwm, is on timer 0 or a timer taken with
+// timerAcquire(), or the frequency is out of range.
+unsigned long pwmConfigure(uint8_t pin, unsigned long frequency, uint8_t mode)
+{
+	volatile uint8_t *tccra;
+	uint8_t n = pwmTimer(pin, &tccra);
+	uint8_t oldSREG;
+	uint8_t cs;
+
+	if (n == 0xFF || n == 0 || frequency == 0)
+		return 0;
+
+	if (timerIs16Bit(n)) {
+		unsigned long top = 0;
+
+		for (cs = 0; cs < sizeof(shift16); cs++) {
+			top = (F_CPU >> shift16[cs]) / frequency;
+			if (mode == PWM_PHASE_CORRECT)
+				top /= 2;
+			else
+				top -= 1;
+			if (top <= 65535)
+				break;
+		}
+		// insist on at least 2 bits
+		if (cs == sizeof(shift16) || top < 3)
+			return 0;
+
+		oldSREG = SREG;
+		CRITICAL_BEGIN(oldSREG);
+		tccra[1] = 0;
+		tccra[0] = (tccra[0] & ~(_BV(WGM11) | _BV(WGM10))) | _BV(WGM11);
+		*(volatile uint16_t *) (tccra + 6) = top;
+		*(volatile uint16_t *) (tccra + 4) = 0;
+		tccra[1] = _BV(WGM13) | (mode == PWM_PHASE_CORRECT ? 0 : _BV(WGM12)) | (cs + 1);
+		pwm_top[n] = top;
+		CRITICAL_END(oldSREG);
+
+		if (mode == PWM_PHASE_CORRECT)
+			return (F_CPU >> shift16[cs]) / (2 * top);
+		return (F_CPU >> shift16[cs]) / (top + 1);
+	} else {
+		unsigned int steps = (mode == PWM_PHASE_CORRECT) ? 510 : 256;
+		unsigned long best = 0, f;
+		uint8_t i;
+
+		cs = 0;
+		for (i = 0; i < sizeof(shift8); i++) {
+			f = (F_CPU >> shift8[i]) / steps;
+			if (best == 0 || labs((long) (f - frequency)) < labs((long) (best - frequency))) {
+				best = f;
+				cs = i;
+			}
+		}
+
+		oldSREG = SREG;
+		CRITICAL_BEGIN(oldSREG);
+		tccra[0] = (tccra[0] & ~(_BV(WGM21) | _BV(WGM20))) |
+			(mode == PWM_PHASE_CORRECT ? _BV(WGM20) : _BV(WGM21) | _BV(WGM20));
+		tccra[1] = cs + 1;
+		pwm_top[n] = 255;
+		CRITICAL_END(oldSREG);
+
+		return best;
+	}
+}
+
+// Sets the number of bits of duty cycle (2 to 16) on the 16-bit timer
+// behind a pin, keeping its prescaler and fast or phase correct mode, so
+// the frequency follows: 16 bits at 16 MHz with no prescaling is 244 Hz
+// fast, 122 Hz phase correct.  The 8-bit timers only do 8.  Returns 0 if
+// the resolution can't be had.
+uint8_t pwmResolution(uint8_t pin, uint8_t bits)
+{
+	volatile uint8_t *tccra;
+	uint8_t n = pwmTimer(pin, &tccra);
+	uint8_t oldSREG;
+	uint8_t tccrb;
+
+	if (n == 0xFF || n == 0)
+		return 0;
+	if (!timerIs16Bit(n))
+		return bits == 8;
+	if (bits < 2 || bits > 16)
+		return 0;
+
+	oldSREG = SREG;
+	CRITICAL_BEGIN(oldSREG);
+	tccrb = tccra[1];
+	tccra[1] = 0;
+	tccra[0] = (tccra[0] & ~(_BV(WGM11) | _BV(WGM10))) | _BV(WGM11);
+	pwm_top[n] = (bits == 16) ? 0xFFFF : (1U << bits) - 1;
+	*(volatile uint16_t *) (tccra + 6) = pwm_top[n];
+	*(volatile uint16_t *) (tccra + 4) = 0;
+	tccra[1] = _BV(WGM13) | (tccrb & (_BV(WGM12) | _BV(CS12) | _BV(CS11) | _BV(CS10)));
+	CRITICAL_END(oldSREG);
+
+	return 1;
+}
+
+// The duty cycle pwmWrite() treats as fully on for a pin, 255 until its
+// timer is reconfigured; 0 if the pin has no pwm or its timer has been
+// taken over.
+unsigned int pwmTop(uint8_t pin)
+{
+	volatile uint8_t *tccra;
+	uint8_t n = pwmTimer(pin, &tccra);
+
+	if (n == 0xFF)
+		return 0;
+	return pwm_top[n];
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+  wiring_sampler.c - statistical profiling
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+#include "wiring_profile.h"
+
+#if defined(TIMSK0) && defined(OCIE0A)
+
+// A sampling profiler on timer 0's compare match A, which takes its
+// channel (pin 6 on the ATmega168/328, 13 on the Mega) away from
+// analogWrite().  The interrupt comes once per timer 0 period, 977 times a
+// second at 16 MHz, and notes where the program was: the return address
+// the interrupt pushed, which sits just above the registers the handler
+// saves.  Addresses in the range given to samplerBegin() are counted in
+// SAMPLER_BINS equal bins, the rest in one more.  The handler then moves
+// the compare point along by 97, so the samples don't lock on to a loop
+// that runs in step with timer 0.
+//
+// Time with interrupts off can't be sampled; it's counted at the point
+// they were turned back on, and time in other interrupt handlers at the
+// point they returned to.  The handler takes about 70 cycles, plus 4 for
+// each bit the addresses are shifted to find the bin: at most 100, 0.6%
+// of the CPU.  tools/sampler.py turns a samplerDump() into a flat profile
+// by function with the sketch's .sym file.
+//
+// Addresses are worked with 16 bits wide, in words; on chips with more
+// than 128 KB of flash they're halved again, so the bins there are at
+// least 4 bytes.
+
+#if defined(__AVR_3_BYTE_PC__)
+#define SAMPLER_PC_SHIFT 2
+#else
+#define SAMPLER_PC_SHIFT 1
+#endif
+
+// referred to by name from the handler, so not static
+unsigned int sampler_bins[SAMPLER_BINS];
+unsigned int sampler_outside;
+unsigned int sampler_base;
+uint8_t sampler_shift;
+
+ISR(TIMER0_COMPA_vect, ISR_NAKED)
+{
+	asm volatile(
+		"push r0\n\t"
+		"in r0, __SREG__\n\t"
+		"push r0\n\t"
+		"push r23\n\t"
+		"push r24\n\t"
+		"push r25\n\t"
+		"push r30\n\t"
+		"push r31\n\t"
+		// the return address, high byte lowest, is above the 7 bytes
+		// just pushed
+		"in r30, __SP_L__\n\t"
+		"in r31, __SP_H__\n\t"
+#if defined(__AVR_3_BYTE_PC__)
+		"ldd r23, Z+8\n\t"
+		"ldd r25, Z+9\n\t"
+		"ldd r24, Z+10\n\t"
+		"lsr r23\n\t"
+		"ror r25\n\t"
+		"ror r24\n\t"
+#else
+		"ldd r25, Z+8\n\t"
+		"ldd r24, Z+9\n\t"
+#endif
+		// bin = (pc - sampler_base) >> sampler_shift
+		"lds r30, sampler_base\n\t"
+		"lds r31, sampler_base+1\n\t"
+		"sub r24, r30\n\t"
+		"sbc r25, r31\n\t"
+		"brcs 2f\n\t"
+		"lds r23, sampler_shift\n\t"
+		"tst r23\n\t"
+		"breq 1f\n"
+	"0:\t"	"lsr r25\n\t"
+		"ror r24\n\t"
+		"dec r23\n\t"
+		"brne 0b\n"
+	"1:\t"	"ldi r23, hi8(%[bins])\n\t"
+		"cpi r24, lo8(%[bins])\n\t"
+		"cpc r25, r23\n\t"
+		"brcc 2f\n\t"
+		"lsl r24\n\t"
+		"rol r25\n\t"
+		"movw r30, r24\n\t"
+		"subi r30, lo8(-(sampler_bins))\n\t"
+		"sbci r31, hi8(-(sampler_bins))\n\t"
+		"rjmp 3f\n"
+	"2:\t"	"ldi r30, lo8(sampler_outside)\n\t"
+		"ldi r31, hi8(sampler_outside)\n"
+		// count, stopping at 65535
+	"3:\t"	"ld r24, Z\n\t"
+		"ldd r25, Z+1\n\t"
+		"adiw r24, 1\n\t"
+		"breq 4f\n\t"
+		"st Z, r24\n\t"
+		"std Z+1, r25\n"
+	"4:\t"	"lds r24, %[ocr]\n\t"
+		"subi r24, lo8(-97)\n\t"
+		"sts %[ocr], r24\n\t"
+		"pop r31\n\t"
+		"pop r30\n\t"
+		"pop r25\n\t"
+		"pop r24\n\t"
+		"pop r23\n\t"
+		"pop r0\n\t"
+		"out __SREG__, r0\n\t"
+		"pop r0\n\t"
+		"reti\n\t"
+		:: [bins] "n" (SAMPLER_BINS), [ocr] "n" (_SFR_MEM_ADDR(OCR0A))
+	);
+}
+
+// Starts sampling, with the bins spread over the flash addresses from
+// from up to to; samplerBegin(0, 0) covers all of it.  Narrowing the range
+// to the code of interest, from the .sym file, makes the bins finer: each
+// is the smallest power of two bytes, 2 or more, that gets the range into
+// SAMPLER_BINS of them.  Returns 0 if timer 0's compare channel A is in
+// use.
+uint8_t samplerBegin(unsigned long from, unsigned long to)
+{
+	unsigned long span;
+	uint8_t shift = 0;
+	uint8_t oldSREG = SREG;
+
+	if (to <= from) {
+		from = 0;
+		to = (unsigned long) FLASHEND + 1;
+	}
+	span = ((to - 1) >> SAMPLER_PC_SHIFT) - (from >> SAMPLER_PC_SHIFT) + 1;
+	while (((span - 1) >> shift) >= SAMPLER_BINS)
+		shift++;
+
+	if (!timerChannelAcquire(0, TIMER_CHANNEL_A, TIMER_OWNER_SAMPLER))
+		return 0;
+
+	cli();
+	sampler_base = from >> SAMPLER_PC_SHIFT;
+	sampler_shift = shift;
+	SREG = oldSREG;
+	samplerReset();
+
+	cli();
+	TIFR0 = _BV(OCF0A);
+	TIMSK0 |= _BV(OCIE0A);
+	SREG = oldSREG;
+
+	return 1;
+}
+
+void samplerEnd()
+{
+	uint8_t oldSREG = SREG;
+
+	if (timerChannelOwner(0, TIMER_CHANNEL_A) != TIMER_OWNER_SAMPLER)
+		return;
+
+	cli();
+	TIMSK0 &= ~_BV(OCIE0A);
+	SREG = oldSREG;
+	timerChannelRelease(0, TIMER_CHANNEL_A, TIMER_OWNER_SAMPLER);
+}
+
+void samplerReset()
+{
+	uint8_t oldSREG = SREG;
+	unsigned int i;
+
+	cli();
+	for (i = 0; i < SAMPLER_BINS; i++)
+		sampler_bins[i] = 0;
+	sampler_outside = 0;
+	SREG = oldSREG;
+}
+
+// The count in a bin, or for bin SAMPLER_BINS, of the samples outside
+// the range.
+unsigned int samplerCount(unsigned int bin)
+{
+	unsigned int n;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	n = (bin < SAMPLER_BINS) ? sampler_bins[bin] : sampler_outside;
+	SREG = oldSREG;
+
+	return n;
+}
+
+// The flash byte address where bin 0 starts, and the width of a bin in
+// bytes.
+unsigned long samplerBase()
+{
+	return (unsigned long) sampler_base << SAMPLER_PC_SHIFT;
+}
+
+unsigned long samplerBinSize()
+{
+	return 1UL << (sampler_shift + SAMPLER_PC_SHIFT);
+}
+
+#endif
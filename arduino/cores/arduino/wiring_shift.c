@@ -23,6 +23,7 @@
 */
 
 #include "wiring_private.h"
+#include "pins_arduino.h"
 
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
 	uint8_t value = 0;
@@ -53,3 +54,247 @@ void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
 		digitalWrite(clockPin, LOW);		
 	}
 }
+
+// The buffer versions below shift whole blocks at a time.  When the pins
+// are the hardware SPI pins from pins_arduino.h (MOSI or MISO for data, SCK
+// for the clock) the SPI unit does the shifting at F_CPU / 2.  On the
+// ATmega168/328 the USART can do the same in master SPI mode when data is
+// on pin 1 (TXD) or 0 (RXD) and the clock on pin 4 (XCK), as long as
+// Serial isn't using it.  Any other pair of pins is bit-banged straight on
+// the port registers, which is still about forty times faster than
+// shiftOut().  All three produce the same waveform as shiftOut()/shiftIn():
+// clock idle low, data valid on the rising edge (SPI mode 0).
+
+#if defined(SPCR)
+volatile uint8_t spi_owner = SPI_OWNER_NONE;
+
+// Takes the SPI unit for owner if nobody has it.  Returns 0 if it's taken.
+uint8_t spiAcquire(uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t ok = 0;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (spi_owner == SPI_OWNER_NONE) {
+		spi_owner = owner;
+		ok = 1;
+	}
+	CRITICAL_END(oldSREG);
+
+	return ok;
+}
+
+// returns 0, leaving the unit alone, while queued wiring_spi
+// transactions have it; the caller bit-bangs instead.
+static uint8_t spiShiftBegin(uint8_t bitOrder, uint8_t *saved)
+{
+	if (!spiAcquire(SPI_OWNER_SHIFT))
+		return 0;
+
+	saved[0] = SPCR;
+	saved[1] = SPSR;
+
+	// the SPI unit drops out of master mode if SS is an input that goes
+	// low, so make it an output the same way the SPI library does.
+	if (!(*portModeRegister(digitalPinToPort(SS)) & digitalPinToBitMask(SS))) {
+		digitalWrite(SS, HIGH);
+		pinMode(SS, OUTPUT);
+	}
+
+	SPCR = _BV(SPE) | _BV(MSTR) | (bitOrder == LSBFIRST ? _BV(DORD) : 0);
+	SPSR = _BV(SPI2X);
+	return 1;
+}
+
+static void spiShiftEnd(uint8_t *saved)
+{
+	SPCR = saved[0];
+	SPSR = saved[1];
+	spi_owner = SPI_OWNER_NONE;
+}
+#endif
+
+#if defined(UCSR0C) && defined(UMSEL01) && !defined(UBRR1H)
+#define SHIFT_MSPIM_DATA_OUT 1
+#define SHIFT_MSPIM_DATA_IN 0
+#define SHIFT_MSPIM_CLOCK 4
+
+static uint8_t mspimShiftBegin(uint8_t bitOrder, uint8_t rx, uint8_t *saved)
+{
+	// leave the USART alone while Serial has it
+	if (UCSR0B & (_BV(RXEN0) | _BV(TXEN0)))
+		return 0;
+
+	saved[0] = UCSR0C;
+	saved[1] = UBRR0H;
+	saved[2] = UBRR0L;
+
+	pinMode(SHIFT_MSPIM_CLOCK, OUTPUT);
+	UBRR0H = 0;
+	UBRR0L = 0;
+	UCSR0C = _BV(UMSEL01) | _BV(UMSEL00) | (bitOrder == LSBFIRST ? _BV(UDORD0) : 0);
+	UCSR0B = _BV(TXEN0) | (rx ? _BV(RXEN0) : 0);
+	// the baud rate has to be set after the transmitter is enabled;
+	// zero gives the fastest clock, F_CPU / 2.
+	UBRR0H = 0;
+	UBRR0L = 0;
+	return 1;
+}
+
+static void mspimShiftEnd(uint8_t *saved)
+{
+	// wait for the last frame to leave the shift register
+	while (!(UCSR0A & _BV(TXC0)))
+		;
+	UCSR0B = 0;
+	UCSR0C = saved[0];
+	UBRR0H = saved[1];
+	UBRR0L = saved[2];
+}
+#endif
+
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder,
+	const uint8_t *buf, unsigned int len)
+{
+	volatile uint8_t *dataOut, *clockOut;
+	uint8_t dataMask, clockMask;
+	uint8_t saved[3];
+
+	// the usart path waits for a frame to go out, so there must be one
+	if (len == 0)
+		return;
+
+	// this also turns off pwm on either pin, as shiftOut() would
+	digitalWrite(clockPin, LOW);
+	digitalWrite(dataPin, LOW);
+
+#if defined(SPCR)
+	if (dataPin == MOSI && clockPin == SCK && spiShiftBegin(bitOrder, saved)) {
+		while (len--) {
+			SPDR = *buf++;
+			while (!(SPSR & _BV(SPIF)))
+				;
+		}
+		spiShiftEnd(saved);
+		return;
+	}
+#endif
+
+#if defined(SHIFT_MSPIM_DATA_OUT)
+	if (dataPin == SHIFT_MSPIM_DATA_OUT && clockPin == SHIFT_MSPIM_CLOCK &&
+	    mspimShiftBegin(bitOrder, 0, saved)) {
+		// clear the stale transmit complete flag so the end-of-transfer
+		// wait in mspimShiftEnd() sees this transfer's flag
+		UCSR0A = _BV(TXC0);
+		while (len--) {
+			while (!(UCSR0A & _BV(UDRE0)))
+				;
+			UDR0 = *buf++;
+		}
+		mspimShiftEnd(saved);
+		return;
+	}
+#endif
+
+	dataOut = portOutputRegister(digitalPinToPort(dataPin));
+	dataMask = digitalPinToBitMask(dataPin);
+	clockOut = portOutputRegister(digitalPinToPort(clockPin));
+	clockMask = digitalPinToBitMask(clockPin);
+
+	while (len--) {
+		uint8_t val = *buf++;
+		uint8_t i;
+		// interrupts are held off for one byte at a time so an ISR
+		// writing to the same port can't lose its change in our
+		// read-modify-write; that's about 8 microseconds at 16 MHz.
+		uint8_t oldSREG = SREG;
+		CRITICAL_BEGIN(oldSREG);
+		for (i = 0; i < 8; i++) {
+			uint8_t b;
+			if (bitOrder == LSBFIRST) {
+				b = val & 0x01;
+				val >>= 1;
+			} else {
+				b = val & 0x80;
+				val <<= 1;
+			}
+			if (b)
+				*dataOut |= dataMask;
+			else
+				*dataOut &= ~dataMask;
+			*clockOut |= clockMask;
+			*clockOut &= ~clockMask;
+		}
+		CRITICAL_END(oldSREG);
+	}
+}
+
+void shiftInBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder,
+	uint8_t *buf, unsigned int len)
+{
+	volatile uint8_t *dataIn, *clockOut;
+	uint8_t dataMask, clockMask;
+	uint8_t saved[3];
+
+	if (len == 0)
+		return;
+
+	digitalWrite(clockPin, LOW);
+
+#if defined(SPCR)
+	if (dataPin == MISO && clockPin == SCK && spiShiftBegin(bitOrder, saved)) {
+		while (len--) {
+			SPDR = 0;
+			while (!(SPSR & _BV(SPIF)))
+				;
+			*buf++ = SPDR;
+		}
+		spiShiftEnd(saved);
+		return;
+	}
+#endif
+
+#if defined(SHIFT_MSPIM_DATA_IN)
+	if (dataPin == SHIFT_MSPIM_DATA_IN && clockPin == SHIFT_MSPIM_CLOCK &&
+	    mspimShiftBegin(bitOrder, 1, saved)) {
+		UCSR0A = _BV(TXC0);
+		while (len--) {
+			while (!(UCSR0A & _BV(UDRE0)))
+				;
+			UDR0 = 0;
+			while (!(UCSR0A & _BV(RXC0)))
+				;
+			*buf++ = UDR0;
+		}
+		mspimShiftEnd(saved);
+		return;
+	}
+#endif
+
+	dataIn = portInputRegister(digitalPinToPort(dataPin));
+	dataMask = digitalPinToBitMask(dataPin);
+	clockOut = portOutputRegister(digitalPinToPort(clockPin));
+	clockMask = digitalPinToBitMask(clockPin);
+
+	while (len--) {
+		uint8_t val = 0;
+		uint8_t i;
+		uint8_t oldSREG = SREG;
+		CRITICAL_BEGIN(oldSREG);
+		for (i = 0; i < 8; i++) {
+			*clockOut |= clockMask;
+			if (bitOrder == LSBFIRST) {
+				val >>= 1;
+				if (*dataIn & dataMask)
+					val |= 0x80;
+			} else {
+				val <<= 1;
+				if (*dataIn & dataMask)
+					val |= 0x01;
+			}
+			*clockOut &= ~clockMask;
+		}
+		CRITICAL_END(oldSREG);
+		*buf++ = val;
+	}
+}
@@ -0,0 +1,355 @@
+/*
+  wiring_softpwm.c - software pwm on any pin
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+#if defined(TCCR2A) && defined(OCR2B)
+
+// Software pwm on up to SOFTPWM_MAX_CHANNELS pins, all on timer 2.  The
+// timer counts 0-255 with a prescale factor of 128, so a period is 32768
+// cycles: 488 Hz at 16 MHz, 244 Hz at 8 MHz, with 8-bit duty cycles just
+// like analogWrite().  Timer 2 can't do hardware pwm (pins 3 and 11 on
+// the ATmega168/328, 9 and 10 on the Mega) or tone() while this runs.
+//
+// The overflow interrupt starts each period, raising every pin whose duty
+// isn't 0.  The pins then have to drop at their own times, so duty
+// changes are compiled into a schedule: a list of (time, port, mask)
+// edges sorted by time, with pins on the same port that drop at the same
+// time merged into one mask.  The compare match B interrupt works down
+// the list, clearing each edge's pins and moving OCR2B on to the next.
+// There are two schedules; softPwmCommit() builds the one not in use and
+// the overflow interrupt switches to it, so a set of changes takes effect
+// together at the start of a period.
+//
+// CPU load, from the instruction counts: about 140 cycles per period for
+// the overflow interrupt with pins on three ports, 40 of them for the
+// dispatch in wiring_timer2.c that lets the synth share it, plus about 75 for
+// each distinct drop time, fewer when pins share one.  With n channels
+// all at different duties that's roughly (100 + 75 * n) / 32768:
+//
+//	channels	 4	 8	16	32
+//	load		1.2%	2.1%	4.0%	7.6%
+//
+// Duties of 0 and 255 cost nothing after the overflow interrupt.
+
+#if !defined(SOFTPWM_MAX_CHANNELS)
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  #define SOFTPWM_MAX_CHANNELS 32
+#else
+  #define SOFTPWM_MAX_CHANNELS 16
+#endif
+#endif
+
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SOFTPWM_MAX_PORTS 11
+#else
+#define SOFTPWM_MAX_PORTS 3
+#endif
+
+struct softpwm_channel {
+	uint8_t pin;
+	uint8_t duty;
+	volatile uint8_t *out;
+	uint8_t mask;
+};
+
+struct softpwm_edge {
+	volatile uint8_t *out;
+	uint8_t mask;
+	uint8_t time;
+};
+
+struct softpwm_port {
+	volatile uint8_t *out;
+	uint8_t all;		// every soft pwm pin on the port
+	uint8_t on;		// the ones raised at the start of a period
+};
+
+struct softpwm_schedule {
+	uint8_t ports;
+	uint8_t edges;
+	struct softpwm_port port[SOFTPWM_MAX_PORTS];
+	struct softpwm_edge edge[SOFTPWM_MAX_CHANNELS];
+};
+
+static struct softpwm_channel softpwm_channels[SOFTPWM_MAX_CHANNELS];
+static uint8_t softpwm_count;
+
+static struct softpwm_schedule softpwm_schedules[2];
+static struct softpwm_schedule *softpwm_run = &softpwm_schedules[0];
+static volatile uint8_t softpwm_front;
+static volatile uint8_t softpwm_pending;
+static uint8_t softpwm_next;
+
+// the timer 2 overflow interrupt, through timer2Overflow()
+static void softPwmOverflow()
+{
+	struct softpwm_schedule *s;
+	uint8_t i;
+
+	if (softpwm_pending) {
+		softpwm_front ^= 1;
+		softpwm_pending = 0;
+	}
+	s = &softpwm_schedules[softpwm_front];
+	softpwm_run = s;
+
+	for (i = 0; i < s->ports; i++) {
+		volatile uint8_t *out = s->port[i].out;
+		*out = (*out & ~s->port[i].all) | s->port[i].on;
+	}
+
+	softpwm_next = 0;
+	if (s->edges)
+		OCR2B = s->edge[0].time;
+}
+
+SIGNAL(TIMER2_COMPB_vect)
+{
+	struct softpwm_schedule *s = softpwm_run;
+	uint8_t i = softpwm_next;
+
+	// take every edge that's due or due on the next tick, so that OCR2B
+	// is always set ahead of the count; a tick is 128 cycles, enough to
+	// get out of this loop.
+	while (i < s->edges && s->edge[i].time <= TCNT2 + 1) {
+		*s->edge[i].out &= ~s->edge[i].mask;
+		i++;
+	}
+	softpwm_next = i;
+	if (i < s->edges)
+		OCR2B = s->edge[i].time;
+}
+
+// Makes the swap the overflow interrupt would, in the middle of a period,
+// for when interrupts are off and it can't come.  Pins whose new drop
+// time has passed go low at once, as the compare interrupt would have
+// had them, and so do pins now at duty 0.  Called with interrupts off.
+static void softPwmSwap()
+{
+	struct softpwm_schedule *s;
+	uint8_t i;
+
+	softpwm_front ^= 1;
+	softpwm_pending = 0;
+	s = &softpwm_schedules[softpwm_front];
+	softpwm_run = s;
+
+	for (i = 0; i < s->ports; i++)
+		*s->port[i].out &= ~(s->port[i].all & ~s->port[i].on);
+	for (i = 0; i < s->edges && s->edge[i].time <= TCNT2; i++)
+		*s->edge[i].out &= ~s->edge[i].mask;
+	softpwm_next = i;
+	if (i < s->edges)
+		OCR2B = s->edge[i].time;
+}
+
+static struct softpwm_channel *softPwmFind(uint8_t pin)
+{
+	uint8_t i;
+
+	for (i = 0; i < softpwm_count; i++)
+		if (softpwm_channels[i].pin == pin)
+			return &softpwm_channels[i];
+	return 0;
+}
+
+static void softPwmBuild(struct softpwm_schedule *s)
+{
+	uint8_t i, j, k;
+
+	s->ports = 0;
+	s->edges = 0;
+
+	for (i = 0; i < softpwm_count; i++) {
+		struct softpwm_channel *c = &softpwm_channels[i];
+		uint8_t time = c->duty;
+
+		for (j = 0; j < s->ports && s->port[j].out != c->out; j++)
+			;
+		if (j == s->ports) {
+			s->port[j].out = c->out;
+			s->port[j].all = 0;
+			s->port[j].on = 0;
+			s->ports++;
+		}
+		s->port[j].all |= c->mask;
+		if (time != 0)
+			s->port[j].on |= c->mask;
+
+		if (time == 0 || time == 255)
+			continue;
+
+		// insertion sort by time, merging with an edge for the same
+		// port at the same time
+		for (j = 0; j < s->edges && s->edge[j].time <= time; j++)
+			if (s->edge[j].time == time && s->edge[j].out == c->out)
+				break;
+		if (j < s->edges && s->edge[j].time == time && s->edge[j].out == c->out) {
+			s->edge[j].mask |= c->mask;
+			continue;
+		}
+		for (k = s->edges; k > j; k--)
+			s->edge[k] = s->edge[k - 1];
+		s->edge[j].out = c->out;
+		s->edge[j].mask = c->mask;
+		s->edge[j].time = time;
+		s->edges++;
+	}
+}
+
+// Builds a schedule from the staged duties and has it take over at the
+// start of the next period.  Commits that come faster than that replace
+// each other; the last one wins.
+void softPwmCommit()
+{
+	uint8_t oldSREG = SREG;
+
+	// once pending is clear the interrupt won't touch the back schedule
+	cli();
+	softpwm_pending = 0;
+	SREG = oldSREG;
+
+	softPwmBuild(&softpwm_schedules[softpwm_front ^ 1]);
+	softpwm_pending = 1;
+}
+
+static void softPwmBegin()
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	TCCR2B = 0;
+	TCCR2A = 0;
+	TCNT2 = 0;
+	OCR2B = 255;
+	TIFR2 = _BV(OCF2B) | _BV(TOV2);
+	timer2Overflow(softPwmOverflow);
+	TIMSK2 = _BV(OCIE2B) | _BV(TOIE2);
+	TCCR2B = _BV(CS22) | _BV(CS20);	// prescale factor 128, normal mode
+	SREG = oldSREG;
+}
+
+static void softPwmEnd()
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	TIMSK2 = 0;
+	timer2Overflow(0);
+	// put timer 2 back the way init() left it: prescale factor 64,
+	// 8-bit phase correct pwm
+	TCCR2B = _BV(CS22);
+	TCCR2A = _BV(WGM20);
+	softpwm_front = 0;
+	softpwm_pending = 0;
+	softpwm_schedules[0].ports = 0;
+	softpwm_schedules[0].edges = 0;
+	softpwm_run = &softpwm_schedules[0];
+	SREG = oldSREG;
+	timerRelease(2, TIMER_OWNER_SOFTPWM);
+}
+
+// Adds a pin to the soft pwm set, at duty 0, taking over timer 2 with the
+// first one.  Returns 0 if the pin isn't valid, the set is full or timer 2
+// is in use.
+uint8_t softPwmAttach(uint8_t pin)
+{
+	uint8_t port = digitalPinToPort(pin);
+	struct softpwm_channel *c;
+
+	if (port == NOT_A_PIN)
+		return 0;
+	if (softPwmFind(pin))
+		return 1;
+	if (softpwm_count == SOFTPWM_MAX_CHANNELS)
+		return 0;
+	if (softpwm_count == 0 && !timerAcquire(2, TIMER_OWNER_SOFTPWM))
+		return 0;
+
+	digitalWrite(pin, LOW);
+	pinMode(pin, OUTPUT);
+
+	c = &softpwm_channels[softpwm_count];
+	c->pin = pin;
+	c->duty = 0;
+	c->out = portOutputRegister(port);
+	c->mask = digitalPinToBitMask(pin);
+
+	if (softpwm_count++ == 0)
+		softPwmBegin();
+
+	return 1;
+}
+
+// Takes a pin out of the set, leaving it low.  Timer 2 goes back to
+// hardware pwm when the last one goes.  With interrupts on, this waits
+// for the start of the next period to drop the pin from the schedule;
+// with them off, it makes the change there and then.
+void softPwmDetach(uint8_t pin)
+{
+	struct softpwm_channel *c = softPwmFind(pin);
+	uint8_t oldSREG;
+
+	if (c == 0)
+		return;
+
+	*c = softpwm_channels[--softpwm_count];
+	if (softpwm_count == 0) {
+		softPwmEnd();
+	} else {
+		softPwmCommit();
+		// until the new schedule takes over the pin may still be
+		// raised; wait for it, unless the interrupt can't come
+		if (SREG & _BV(SREG_I)) {
+			while (softpwm_pending)
+				;
+		} else {
+			softPwmSwap();
+		}
+	}
+
+	oldSREG = SREG;
+	cli();
+	*portOutputRegister(digitalPinToPort(pin)) &= ~digitalPinToBitMask(pin);
+	SREG = oldSREG;
+}
+
+// Sets the duty of a soft pwm pin, 0 (off) to 255 (on), without applying
+// it; softPwmCommit() applies every staged change at once.
+void softPwmStage(uint8_t pin, uint8_t duty)
+{
+	struct softpwm_channel *c = softPwmFind(pin);
+
+	if (c)
+		c->duty = duty;
+}
+
+// Sets the duty of a soft pwm pin and commits it.
+void softPwmWrite(uint8_t pin, uint8_t duty)
+{
+	softPwmStage(pin, duty);
+	softPwmCommit();
+}
+
+#endif
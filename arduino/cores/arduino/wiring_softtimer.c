@@ -0,0 +1,180 @@
+/*
+  wiring_softtimer.c - software timers
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+
+// Software timers in a hashed timer wheel.  A timer due at millisecond t
+// hangs off slot t % SOFT_TIMER_SLOTS, unsorted, so starting or stopping
+// one is constant time, and each millisecond only the timers in its own
+// slot are looked at, however many there are in all.
+//
+// The wheel is turned by softTimerRun(), which main() calls between
+// passes through loop() whenever these timers are linked in, so the
+// callbacks run in loop() context, where they can take their time and
+// call anything.  It catches up on every millisecond since the last call
+// (or just visits each slot once, after a long stall), so a slow loop()
+// delays callbacks but never loses them.  Running the wheel from the
+// timer 0 interrupt instead would have cost every sketch a function call
+// from that interrupt, and the callbacks would have to be queued for
+// loop() anyway.
+//
+// None of this may be called from an interrupt.
+
+#if !defined(SOFT_TIMER_SLOTS)
+#define SOFT_TIMER_SLOTS 16
+#endif
+
+#if (SOFT_TIMER_SLOTS & (SOFT_TIMER_SLOTS - 1))
+#error SOFT_TIMER_SLOTS must be a power of two
+#endif
+
+// where a started timer is: on the wheel, or on the list softTimerRun()
+// is working through
+#define SOFT_TIMER_WHEEL 1
+#define SOFT_TIMER_DUE 2
+
+static soft_timer *soft_timer_wheel[SOFT_TIMER_SLOTS];
+static soft_timer *soft_timer_due;
+static unsigned long soft_timer_now;	// the next millisecond to visit
+static uint8_t soft_timer_count;
+
+static void softTimerInsert(soft_timer *t)
+{
+	soft_timer **slot = &soft_timer_wheel[t->expires & (SOFT_TIMER_SLOTS - 1)];
+
+	t->next = *slot;
+	*slot = t;
+	t->pending = SOFT_TIMER_WHEEL;
+}
+
+static void softTimerStart(soft_timer *t, unsigned long ms, unsigned long period,
+	void (*callback)(void *), void *arg)
+{
+	unsigned long now = millis();
+
+	softTimerStop(t);
+	if (soft_timer_count++ == 0)
+		soft_timer_now = now;
+
+	// not before the next millisecond the wheel visits: with ms 0, from
+	// a callback say, now's slot has been and gone
+	t->expires = now + ms;
+	if ((long) (t->expires - soft_timer_now) < 0)
+		t->expires = soft_timer_now;
+	t->period = period;
+	t->callback = callback;
+	t->arg = arg;
+	softTimerInsert(t);
+}
+
+// Calls callback(arg) once, ms milliseconds from now; with 0, on the
+// next softTimerRun() that finds a new millisecond.
+void softTimerOnce(soft_timer *t, unsigned long ms, void (*callback)(void *), void *arg)
+{
+	softTimerStart(t, ms, 0, callback, arg);
+}
+
+// Calls callback(arg) every ms milliseconds, starting ms from now.  The
+// period is kept without drift; calls missed while loop() was held up
+// are skipped rather than made in a burst.
+void softTimerEvery(soft_timer *t, unsigned long ms, void (*callback)(void *), void *arg)
+{
+	if (ms == 0)
+		ms = 1;
+	softTimerStart(t, ms, ms, callback, arg);
+}
+
+void softTimerStop(soft_timer *t)
+{
+	soft_timer **p;
+
+	if (!t->pending)
+		return;
+
+	if (t->pending == SOFT_TIMER_DUE)
+		p = &soft_timer_due;
+	else
+		p = &soft_timer_wheel[t->expires & (SOFT_TIMER_SLOTS - 1)];
+	for (; *p; p = &(*p)->next) {
+		if (*p == t) {
+			*p = t->next;
+			break;
+		}
+	}
+	t->pending = 0;
+	soft_timer_count--;
+}
+
+void softTimerRun()
+{
+	unsigned long now;
+	unsigned long n;
+
+	if (soft_timer_count == 0)
+		return;
+
+	now = millis();
+	if ((long) (now - soft_timer_now) < 0)
+		return;
+
+	n = now - soft_timer_now + 1;
+	if (n > SOFT_TIMER_SLOTS)
+		n = SOFT_TIMER_SLOTS;
+
+	// unhook everything that's due first, so the callbacks are free to
+	// start and stop timers, these ones included: stopping one that's
+	// still waiting its turn takes it off soft_timer_due, so it doesn't
+	// fire
+	for (; n > 0; n--, soft_timer_now++) {
+		soft_timer **p = &soft_timer_wheel[soft_timer_now & (SOFT_TIMER_SLOTS - 1)];
+
+		while (*p) {
+			soft_timer *t = *p;
+
+			if ((long) (t->expires - now) <= 0) {
+				*p = t->next;
+				t->next = soft_timer_due;
+				t->pending = SOFT_TIMER_DUE;
+				soft_timer_due = t;
+			} else {
+				p = &t->next;
+			}
+		}
+	}
+	soft_timer_now = now + 1;
+
+	while (soft_timer_due) {
+		soft_timer *t = soft_timer_due;
+
+		soft_timer_due = t->next;
+		if (t->period) {
+			t->expires += t->period;
+			if ((long) (t->expires - now) <= 0)
+				t->expires = now + t->period;
+			softTimerInsert(t);
+		} else {
+			t->pending = 0;
+			soft_timer_count--;
+		}
+		t->callback(t->arg);
+	}
+}
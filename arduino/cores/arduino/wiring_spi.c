@@ -0,0 +1,199 @@
+/*
+  wiring_spi.c - interrupt driven SPI master
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+#include "wiring_spi.h"
+
+#if defined(SPCR)
+
+// Transactions wait in a singly linked list threaded through their own
+// next pointers, so the queue needs no storage of its own and has no fixed
+// depth.  The SPI transfer complete interrupt moves one byte at a time and
+// starts the next transaction when the current one finishes, so loop()
+// only has to queue work and check the status later.
+//
+// The queue holds the SPI unit (spi_owner) from the time something is
+// queued onto it empty until it drains, so shiftOutBuffer() bit-bangs
+// rather than take the bus in the middle of a transaction.
+
+static spi_transaction * volatile spi_head = 0;
+static spi_transaction *spi_tail = 0;
+static unsigned int spi_pos;
+
+static void spiStart(spi_transaction *t)
+{
+	spi_device *dev = t->device;
+
+	t->status = SPI_ACTIVE;
+	spi_pos = 0;
+	SPCR = dev->spcr;
+	SPSR = dev->spsr;
+	*dev->csPort &= ~dev->csMask;
+	SPDR = t->txBuffer ? t->txBuffer[0] : 0xFF;
+}
+
+// finishes the transaction at the head of the queue and starts the next
+// one; called with interrupts disabled.
+static void spiFinish(spi_transaction *t)
+{
+	*t->device->csPort |= t->device->csMask;
+
+	spi_head = t->next;
+	if (spi_head == 0)
+		spi_tail = 0;
+	t->next = 0;
+	t->status = SPI_DONE;
+
+	// get the next transaction onto the wire before running the
+	// callback, so a slow callback doesn't leave the bus idle
+	if (spi_head)
+		spiStart(spi_head);
+
+	if (t->callback)
+		t->callback(t);
+
+	// anything the callback queued onto an empty queue has been started
+	// by spiQueue() already
+	if (spi_head == 0) {
+		cbi(SPCR, SPIE);
+		spi_owner = SPI_OWNER_NONE;
+	}
+}
+
+SIGNAL(SPI_STC_vect)
+{
+	spi_transaction *t = spi_head;
+	uint8_t c = SPDR;
+
+	if (t == 0)
+		return;
+
+	if (t->rxBuffer)
+		t->rxBuffer[spi_pos] = c;
+
+	if (++spi_pos < t->length)
+		SPDR = t->txBuffer ? t->txBuffer[spi_pos] : 0xFF;
+	else
+		spiFinish(t);
+}
+
+void spiBegin()
+{
+	// SS has to be an output for the SPI unit to stay in master mode
+	digitalWrite(SS, HIGH);
+	pinMode(SS, OUTPUT);
+	pinMode(SCK, OUTPUT);
+	pinMode(MOSI, OUTPUT);
+	pinMode(MISO, INPUT);
+	digitalWrite(SCK, LOW);
+	digitalWrite(MOSI, LOW);
+
+	SPCR = _BV(SPE) | _BV(MSTR);
+}
+
+void spiEnd()
+{
+	while (spiBusy())
+		;
+	SPCR = 0;
+}
+
+void spiDeviceInit(spi_device *device, uint8_t csPin, uint8_t mode,
+	uint8_t clockDiv, uint8_t bitOrder)
+{
+	device->spcr = _BV(SPIE) | _BV(SPE) | _BV(MSTR) |
+		(bitOrder == LSBFIRST ? _BV(DORD) : 0) |
+		(mode & (_BV(CPOL) | _BV(CPHA))) |
+		(clockDiv & (_BV(SPR1) | _BV(SPR0)));
+	device->spsr = (clockDiv & 0x04) ? _BV(SPI2X) : 0;
+	device->csPort = portOutputRegister(digitalPinToPort(csPin));
+	device->csMask = digitalPinToBitMask(csPin);
+
+	digitalWrite(csPin, HIGH);
+	pinMode(csPin, OUTPUT);
+}
+
+// Appends a transaction to the queue, starting it straight away if the bus
+// is idle.  Returns 0 if the transaction is empty or already queued or
+// running, or if a buffered shift has the SPI unit.
+uint8_t spiQueue(spi_transaction *transaction)
+{
+	uint8_t oldSREG = SREG;
+
+	if (transaction->status == SPI_QUEUED || transaction->status == SPI_ACTIVE)
+		return 0;
+	if (transaction->length == 0)
+		return 0;
+
+	transaction->next = 0;
+
+	cli();
+	if (spi_tail) {
+		transaction->status = SPI_QUEUED;
+		spi_tail->next = transaction;
+		spi_tail = transaction;
+	} else if (spi_owner == SPI_OWNER_NONE || spi_owner == SPI_OWNER_QUEUE) {
+		// still ours if a callback is queueing onto the queue it
+		// just emptied
+		spi_owner = SPI_OWNER_QUEUE;
+		transaction->status = SPI_QUEUED;
+		spi_head = spi_tail = transaction;
+		spiStart(transaction);
+	} else {
+		SREG = oldSREG;
+		return 0;
+	}
+	SREG = oldSREG;
+
+	return 1;
+}
+
+uint8_t spiBusy()
+{
+	return spi_head != 0;
+}
+
+// Blocking transfer through the same queue, for code that has nothing
+// better to do while it waits.  Must not be called with interrupts off.
+void spiTransfer(spi_device *device, const uint8_t *txBuffer,
+	uint8_t *rxBuffer, unsigned int length)
+{
+	spi_transaction t;
+
+	if (length == 0)
+		return;
+
+	t.device = device;
+	t.txBuffer = txBuffer;
+	t.rxBuffer = rxBuffer;
+	t.length = length;
+	t.status = SPI_IDLE;
+	t.callback = 0;
+
+	while (!spiQueue(&t))
+		;
+	while (t.status != SPI_DONE)
+		;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+  wiring_spi.h - interrupt driven SPI master
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#ifndef WiringSPI_h
+#define WiringSPI_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// clock polarity and phase, already in their SPCR positions
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+// SPR1:SPR0 in the low bits, SPI2X in bit 2
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_CLOCK_DIV64 0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV32 0x06
+
+// spi_transaction.status
+#define SPI_IDLE 0
+#define SPI_QUEUED 1
+#define SPI_ACTIVE 2
+#define SPI_DONE 3
+
+// Settings for one peripheral on the bus, worked out once by
+// spiDeviceInit() so that starting a transaction is two register writes.
+typedef struct {
+	uint8_t spcr;
+	uint8_t spsr;
+	volatile uint8_t *csPort;
+	uint8_t csMask;
+} spi_device;
+
+// One chip select cycle: length bytes are clocked out of txBuffer (or 0xFF
+// if it is NULL) and the bytes clocked in are stored to rxBuffer (unless it
+// is NULL).  The caller owns the storage, which must stay put until status
+// reaches SPI_DONE.  The callback, if any, always runs in interrupt
+// context, so spiQueue() turns down a transaction with length 0.
+typedef struct spi_transaction {
+	struct spi_transaction *next;
+	spi_device *device;
+	const uint8_t *txBuffer;
+	uint8_t *rxBuffer;
+	unsigned int length;
+	volatile uint8_t status;
+	void (*callback)(struct spi_transaction *);
+} spi_transaction;
+
+void spiBegin(void);
+void spiEnd(void);
+void spiDeviceInit(spi_device *device, uint8_t csPin, uint8_t mode, uint8_t clockDiv, uint8_t bitOrder);
+uint8_t spiQueue(spi_transaction *transaction);
+uint8_t spiBusy(void);
+void spiTransfer(spi_device *device, const uint8_t *txBuffer, uint8_t *rxBuffer, unsigned int length);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,405 @@
+/*
+  wiring_synth.c - polyphonic tone synthesis
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include <string.h>
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+#include "wiring_synth.h"
+
+#if defined(TCCR2A) && defined(OCR2B)
+
+// Direct digital synthesis of SYNTH_VOICES voices on timer 2.  The timer
+// runs 8-bit phase correct pwm with no prescaling, so its carrier (31 kHz
+// at 16 MHz) is out of earshot, and every other overflow interrupt makes
+// a sample.  Each voice adds its increment to a 16-bit phase, looks up
+// its waveform at the top byte of the phase and scales it by its envelope
+// level; the voices are mixed into OCR2B, whose pin (SYNTH_PWM_PIN) wants
+// an RC low-pass or a speaker that does the same.  A voice given a pin of
+// its own with synthPin() instead drives that pin high for the first half
+// of each cycle and low for the second: a square wave at full volume that
+// needs no filtering, the envelope only switching it on and off.
+//
+// Frequencies come in steps of SYNTH_RATE / 65536, 0.24 Hz at 16 MHz, up
+// to half the sample rate.  Every SYNTH_TICK samples the interrupt also
+// moves each envelope a step and each sequence along, reading the next
+// note straight from program memory; the notes are stored already
+// converted, so that costs no division.  Once every voice is silent the
+// interrupt turns itself off.  Timer 2 is taken with timerAcquire(), so
+// analogWrite() on its pins, soft pwm and a tone() on timer 2 are out
+// while this runs.  Soft pwm uses the overflow interrupt too; both reach
+// it through timer2Overflow() (see wiring_timer2.c).
+//
+// ISR cost, from the instruction counts: about 140 cycles for a sample
+// and 125 for a skipped overflow, 40 of each for the shared dispatch,
+// plus per sounding voice
+//
+//	square, saw	 45
+//	triangle	 50
+//	sine		 50
+//	own pin		 40
+//
+// and 6 for a silent one.  A sample period is 1020 cycles, so with square
+// waves the load is about
+//
+//	voices		 1	 2	 3	 4
+//	load		 30%	 35%	 39%	 44%
+//
+// The envelope and sequence step adds about 30 cycles per voice, 55 when a
+// new note starts, once per SYNTH_TICK samples.
+
+#define SYNTH_OFF 0
+#define SYNTH_SUSTAIN 1
+#define SYNTH_ATTACK 2
+#define SYNTH_RELEASE 3
+
+struct synth_voice {
+	uint16_t phase;
+	uint16_t increment;
+	uint8_t level;		// where the envelope is now
+	uint8_t wave;
+	volatile uint8_t *out;	// a pin of its own, or 0 to mix
+	uint8_t mask;
+	uint8_t state;
+	uint8_t volume;		// where the attack stops
+	uint8_t attack;		// level per tick, 0 for at once
+	uint8_t release;
+	const synth_note *note;	// where a sequence has got to
+	const synth_note *sequence;
+	uint16_t ticks;		// left of the current note
+	uint8_t loop;
+};
+
+static struct synth_voice synth_voices[SYNTH_VOICES];
+static uint8_t synth_odd;
+static uint8_t synth_tick;
+
+static const int8_t PROGMEM synth_sine[256] = {
+	0, 3, 6, 9, 12, 16, 19, 22, 25, 28, 31, 34, 37, 40, 43, 46,
+	49, 51, 54, 57, 60, 63, 65, 68, 71, 73, 76, 78, 81, 83, 85, 88,
+	90, 92, 94, 96, 98, 100, 102, 104, 106, 107, 109, 111, 112, 113, 115, 116,
+	117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127,
+	127, 127, 127, 127, 126, 126, 126, 125, 125, 124, 123, 122, 122, 121, 120, 118,
+	117, 116, 115, 113, 112, 111, 109, 107, 106, 104, 102, 100, 98, 96, 94, 92,
+	90, 88, 85, 83, 81, 78, 76, 73, 71, 68, 65, 63, 60, 57, 54, 51,
+	49, 46, 43, 40, 37, 34, 31, 28, 25, 22, 19, 16, 12, 9, 6, 3,
+	0, -3, -6, -9, -12, -16, -19, -22, -25, -28, -31, -34, -37, -40, -43, -46,
+	-49, -51, -54, -57, -60, -63, -65, -68, -71, -73, -76, -78, -81, -83, -85, -88,
+	-90, -92, -94, -96, -98, -100, -102, -104, -106, -107, -109, -111, -112, -113, -115, -116,
+	-117, -118, -120, -121, -122, -122, -123, -124, -125, -125, -126, -126, -126, -127, -127, -127,
+	-127, -127, -127, -127, -126, -126, -126, -125, -125, -124, -123, -122, -122, -121, -120, -118,
+	-117, -116, -115, -113, -112, -111, -109, -107, -106, -104, -102, -100, -98, -96, -94, -92,
+	-90, -88, -85, -83, -81, -78, -76, -73, -71, -68, -65, -63, -60, -57, -54, -51,
+	-49, -46, -43, -40, -37, -34, -31, -28, -25, -22, -19, -16, -12, -9, -6, -3,
+};
+
+// These run inside the interrupt; a real call there would cost another
+// round of saving registers on each sample.
+static inline void synthStart(struct synth_voice *v, const synth_note *n) __attribute__ ((always_inline));
+static inline void synthStep(struct synth_voice *v) __attribute__ ((always_inline));
+
+// Starts a note of a sequence, or a rest.  Notes run into each other
+// without a new attack unless a rest comes between them.
+static inline void synthStart(struct synth_voice *v, const synth_note *n)
+{
+	uint16_t increment = pgm_read_word(&n->increment);
+
+	v->note = n;
+	v->ticks = pgm_read_word(&n->ticks);
+	if (increment == 0) {
+		v->state = SYNTH_RELEASE;
+	} else {
+		v->increment = increment;
+		if (v->state != SYNTH_SUSTAIN)
+			v->state = SYNTH_ATTACK;
+	}
+}
+
+static inline void synthStep(struct synth_voice *v)
+{
+	uint8_t step;
+
+	if (v->note && --v->ticks == 0) {
+		const synth_note *n = v->note + 1;
+
+		if (pgm_read_word(&n->ticks) == 0)
+			n = v->loop ? v->sequence : 0;
+		if (n) {
+			synthStart(v, n);
+		} else {
+			v->note = 0;
+			v->state = SYNTH_RELEASE;
+		}
+	}
+
+	switch (v->state) {
+	case SYNTH_ATTACK:
+		step = v->attack ? v->attack : 255;
+		if (v->level >= v->volume || v->volume - v->level <= step) {
+			v->level = v->volume;
+			v->state = SYNTH_SUSTAIN;
+		} else {
+			v->level += step;
+		}
+		break;
+	case SYNTH_RELEASE:
+		step = v->release ? v->release : 255;
+		if (v->level <= step) {
+			v->level = 0;
+			v->state = SYNTH_OFF;
+			if (v->out)
+				*v->out &= ~v->mask;
+		} else {
+			v->level -= step;
+		}
+		break;
+	}
+}
+
+// the timer 2 overflow interrupt, through timer2Overflow()
+static void synthOverflow()
+{
+	struct synth_voice *v;
+	int mix = 0;
+
+	synth_odd ^= 1;
+	if (synth_odd)
+		return;
+
+	for (v = synth_voices; v < synth_voices + SYNTH_VOICES; v++) {
+		uint8_t p;
+		int8_t s;
+
+		if (v->level == 0)
+			continue;
+		v->phase += v->increment;
+		p = v->phase >> 8;
+
+		if (v->out) {
+			if (p & 0x80)
+				*v->out &= ~v->mask;
+			else
+				*v->out |= v->mask;
+			continue;
+		}
+
+		switch (v->wave) {
+		case SYNTH_SQUARE:
+			s = (p & 0x80) ? -127 : 127;
+			break;
+		case SYNTH_SAW:
+			s = p - 128;
+			break;
+		case SYNTH_TRIANGLE:
+			s = (uint8_t) ((p & 0x80) ? ~(p << 1) : (p << 1)) - 128;
+			break;
+		default:
+			s = pgm_read_byte(&synth_sine[p]);
+			break;
+		}
+		mix += ((int) s * v->level) >> 8;
+	}
+	OCR2B = 128 + mix / SYNTH_VOICES;
+
+	if (--synth_tick == 0) {
+		uint8_t sounding = 0;
+
+		synth_tick = SYNTH_TICK;
+		for (v = synth_voices; v < synth_voices + SYNTH_VOICES; v++) {
+			synthStep(v);
+			if (v->state != SYNTH_OFF || v->note)
+				sounding = 1;
+		}
+		if (!sounding)
+			TIMSK2 = 0;
+	}
+}
+
+// Takes over timer 2 for the engine, silent until a voice is started.
+// Voices are square waves with no envelope and no pin until set up
+// otherwise.  SYNTH_PWM mixes the voices onto SYNTH_PWM_PIN; with
+// SYNTH_TOGGLE that pin is left alone and only voices given pins with
+// synthPin() are heard.  Returns 0 if timer 2 is in use.
+uint8_t synthBegin(uint8_t output)
+{
+	uint8_t oldSREG = SREG;
+
+	if (!timerAcquire(2, TIMER_OWNER_SYNTH))
+		return 0;
+
+	cli();
+	TIMSK2 = 0;
+	TCCR2B = 0;
+	TCCR2A = _BV(WGM20) | (output == SYNTH_PWM ? _BV(COM2B1) : 0);
+	TCNT2 = 0;
+	OCR2B = 128;
+	synth_odd = 0;
+	synth_tick = SYNTH_TICK;
+	TIFR2 = _BV(TOV2);
+	timer2Overflow(synthOverflow);
+	TCCR2B = _BV(CS20);
+	SREG = oldSREG;
+
+	if (output == SYNTH_PWM)
+		pinMode(SYNTH_PWM_PIN, OUTPUT);
+
+	return 1;
+}
+
+// Silences every voice at once, forgets their settings and gives timer 2
+// back to pwm.
+void synthEnd()
+{
+	struct synth_voice *v;
+	uint8_t oldSREG = SREG;
+
+	if (timerOwner(2) != TIMER_OWNER_SYNTH)
+		return;
+
+	cli();
+	TIMSK2 = 0;
+	timer2Overflow(0);
+	// put timer 2 back the way init() left it: prescale factor 64,
+	// 8-bit phase correct pwm
+	TCCR2B = _BV(CS22);
+	TCCR2A = _BV(WGM20);
+	for (v = synth_voices; v < synth_voices + SYNTH_VOICES; v++)
+		if (v->out)
+			*v->out &= ~v->mask;
+	memset(synth_voices, 0, sizeof(synth_voices));
+	SREG = oldSREG;
+
+	timerRelease(2, TIMER_OWNER_SYNTH);
+}
+
+// Gives a voice a pin of its own to toggle, instead of the mix.
+void synthPin(uint8_t voice, uint8_t pin)
+{
+	struct synth_voice *v = &synth_voices[voice];
+	uint8_t port = digitalPinToPort(pin);
+	uint8_t oldSREG;
+
+	if (voice >= SYNTH_VOICES || port == NOT_A_PIN)
+		return;
+
+	digitalWrite(pin, LOW);
+	pinMode(pin, OUTPUT);
+
+	oldSREG = SREG;
+	cli();
+	v->out = portOutputRegister(port);
+	v->mask = digitalPinToBitMask(pin);
+	SREG = oldSREG;
+}
+
+void synthWave(uint8_t voice, uint8_t wave)
+{
+	if (voice < SYNTH_VOICES)
+		synth_voices[voice].wave = wave;
+}
+
+// Sets how fast a voice's level rises at the start of a note and falls at
+// the end, in level steps per SYNTH_TICK; 0 is at once.  An attack of 4
+// takes a note to full volume in 64 ticks, a quarter of a second.
+void synthEnvelope(uint8_t voice, uint8_t attack, uint8_t release)
+{
+	struct synth_voice *v = &synth_voices[voice];
+	uint8_t oldSREG = SREG;
+
+	if (voice >= SYNTH_VOICES)
+		return;
+
+	cli();
+	v->attack = attack;
+	v->release = release;
+	SREG = oldSREG;
+}
+
+// Starts a note at the given level (1-255) until synthNoteOff(), stopping
+// any sequence on the voice.
+void synthNoteOn(uint8_t voice, unsigned int frequency, uint8_t level)
+{
+	struct synth_voice *v = &synth_voices[voice];
+	uint16_t increment = ((unsigned long) frequency << 16) / SYNTH_RATE;
+	uint8_t oldSREG = SREG;
+
+	if (voice >= SYNTH_VOICES || timerOwner(2) != TIMER_OWNER_SYNTH)
+		return;
+
+	cli();
+	v->note = 0;
+	v->increment = increment;
+	v->volume = level;
+	v->state = SYNTH_ATTACK;
+	TIMSK2 = _BV(TOIE2);
+	SREG = oldSREG;
+}
+
+// Lets a note, or a sequence, fade out at the voice's release rate.
+void synthNoteOff(uint8_t voice)
+{
+	struct synth_voice *v = &synth_voices[voice];
+	uint8_t oldSREG = SREG;
+
+	if (voice >= SYNTH_VOICES)
+		return;
+
+	cli();
+	v->note = 0;
+	if (v->state != SYNTH_OFF)
+		v->state = SYNTH_RELEASE;
+	SREG = oldSREG;
+}
+
+// Plays a sequence of notes from program memory on a voice at the given
+// level, over and over if loop is set.  Each voice can play its own.
+void synthPlay(uint8_t voice, const synth_note *sequence, uint8_t level, uint8_t loop)
+{
+	struct synth_voice *v = &synth_voices[voice];
+	uint8_t oldSREG = SREG;
+
+	if (voice >= SYNTH_VOICES || timerOwner(2) != TIMER_OWNER_SYNTH)
+		return;
+	if (pgm_read_word(&sequence->ticks) == 0)
+		return;
+
+	cli();
+	v->sequence = sequence;
+	v->loop = loop;
+	v->volume = level;
+	synthStart(v, sequence);
+	TIMSK2 = _BV(TOIE2);
+	SREG = oldSREG;
+}
+
+// Whether a voice is sounding, fading out or in the middle of a sequence.
+uint8_t synthPlaying(uint8_t voice)
+{
+	struct synth_voice *v = &synth_voices[voice];
+
+	if (voice >= SYNTH_VOICES)
+		return 0;
+	return v->state != SYNTH_OFF || v->note != 0;
+}
+
+#endif
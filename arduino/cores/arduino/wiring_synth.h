@@ -0,0 +1,91 @@
+/*
+  wiring_synth.h - polyphonic tone synthesis
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef WiringSynth_h
+#define WiringSynth_h
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#if !defined(SYNTH_VOICES)
+#define SYNTH_VOICES 4
+#endif
+
+// samples per second: one every other period of timer 2's 8-bit phase
+// correct pwm, 15686 at 16 MHz, 7843 at 8 MHz
+#define SYNTH_RATE (F_CPU / 1020)
+
+// samples per envelope and sequence step, 4.1 ms at 16 MHz
+#define SYNTH_TICK 64
+
+// synthBegin() outputs
+#define SYNTH_PWM 0
+#define SYNTH_TOGGLE 1
+
+// synthWave() waveforms
+#define SYNTH_SQUARE 0
+#define SYNTH_SAW 1
+#define SYNTH_TRIANGLE 2
+#define SYNTH_SINE 3
+
+// the SYNTH_PWM output pin, OC2B
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SYNTH_PWM_PIN 9
+#else
+#define SYNTH_PWM_PIN 3
+#endif
+
+// One step of a sequence for synthPlay(), kept in program memory.  Both
+// fields are in the units the interrupt works in, so write them with
+// SYNTH_NOTE(hertz, milliseconds), which does the conversion at compile
+// time; a frequency of 0 is a rest.  SYNTH_END ends the sequence.
+typedef struct {
+	uint16_t increment;
+	uint16_t ticks;
+} synth_note;
+
+#define SYNTH_INCREMENT(hz) ((uint16_t) ((hz) * 65536.0 / SYNTH_RATE + 0.5))
+#define SYNTH_TICKS(ms) ((ms) * (double) SYNTH_RATE / (1000.0 * SYNTH_TICK) < 1.5 ? 1 : \
+	(uint16_t) ((ms) * (double) SYNTH_RATE / (1000.0 * SYNTH_TICK) + 0.5))
+#define SYNTH_NOTE(hz, ms) { SYNTH_INCREMENT(hz), SYNTH_TICKS(ms) }
+#define SYNTH_END { 0, 0 }
+
+uint8_t synthBegin(uint8_t output);
+void synthEnd(void);
+void synthPin(uint8_t voice, uint8_t pin);
+void synthWave(uint8_t voice, uint8_t wave);
+void synthEnvelope(uint8_t voice, uint8_t attack, uint8_t release);
+void synthNoteOn(uint8_t voice, unsigned int frequency, uint8_t level);
+void synthNoteOff(uint8_t voice);
+void synthPlay(uint8_t voice, const synth_note *sequence, uint8_t level, uint8_t loop);
+uint8_t synthPlaying(uint8_t voice);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+/*
+  wiring_task.c - cooperative task scheduler
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include "wiring_private.h"
+
+// A run-to-completion scheduler.  Each task is released every period
+// milliseconds and, once released, waits its turn by priority: the
+// highest released task runs first, the earliest released first among
+// equals.  Tasks aren't preempted, so a task should do a slice of work
+// and return; and since a released task always beats a lower one, tasks
+// that are always due starve everything below them.
+//
+// Tasks not yet released wait in one binary heap ordered by release time,
+// so the next to be released is always at the top; taskRun() moves the
+// released ones to a second heap ordered by priority and runs its top.
+// Adding or rescheduling a task costs a few swaps.  A task that finishes
+// later than its deadline (the period, unless taskDeadline() says
+// otherwise) after its release counts a miss.
+//
+// main() calls taskRun() first on each pass, and loop() whenever it
+// found nothing to run: with no tasks, none due, or this file not
+// linked in at all, loop() runs as always.  None of this may be called
+// from an interrupt.
+
+#if !defined(SCHED_MAX_TASKS)
+#define SCHED_MAX_TASKS 8
+#endif
+
+#define NOT_SCHEDULED 0xFF
+
+typedef struct {
+	sched_task *task[SCHED_MAX_TASKS];
+	uint8_t count;
+	uint8_t (*before)(sched_task *, sched_task *);
+} sched_queue;
+
+static uint8_t taskReleasedBefore(sched_task *a, sched_task *b)
+{
+	return (long) (a->release - b->release) < 0;
+}
+
+static uint8_t taskReadyBefore(sched_task *a, sched_task *b)
+{
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return (long) (a->release - b->release) < 0;
+}
+
+static sched_queue sched_waiting = { { 0 }, 0, taskReleasedBefore };
+static sched_queue sched_ready = { { 0 }, 0, taskReadyBefore };
+
+static void taskPlace(sched_queue *q, uint8_t i, sched_task *t)
+{
+	q->task[i] = t;
+	t->index = i;
+}
+
+static void taskSiftUp(sched_queue *q, uint8_t i)
+{
+	sched_task *t = q->task[i];
+
+	while (i > 0) {
+		uint8_t parent = (i - 1) / 2;
+		if (!q->before(t, q->task[parent]))
+			break;
+		taskPlace(q, i, q->task[parent]);
+		i = parent;
+	}
+	taskPlace(q, i, t);
+}
+
+static void taskSiftDown(sched_queue *q, uint8_t i)
+{
+	sched_task *t = q->task[i];
+
+	for (;;) {
+		uint8_t child = 2 * i + 1;
+		if (child >= q->count)
+			break;
+		if (child + 1 < q->count && q->before(q->task[child + 1], q->task[child]))
+			child++;
+		if (!q->before(q->task[child], t))
+			break;
+		taskPlace(q, i, q->task[child]);
+		i = child;
+	}
+	taskPlace(q, i, t);
+}
+
+static void taskPush(sched_queue *q, sched_task *t)
+{
+	t->ready = (q == &sched_ready);
+	taskPlace(q, q->count, t);
+	taskSiftUp(q, q->count++);
+}
+
+static void taskUnlink(sched_queue *q, uint8_t i)
+{
+	q->task[i]->index = NOT_SCHEDULED;
+	if (i != --q->count) {
+		taskPlace(q, i, q->task[q->count]);
+		taskSiftDown(q, i);
+		taskSiftUp(q, q->task[i]->index);
+	}
+}
+
+static sched_queue *taskQueue(sched_task *t)
+{
+	sched_queue *q = t->ready ? &sched_ready : &sched_waiting;
+
+	if (t->index >= q->count || q->task[t->index] != t)
+		return 0;
+	return q;
+}
+
+// Adds a task released every period milliseconds, first right away, or
+// just once if the period is 0; higher priorities run first once
+// released.  A task that's already scheduled, even the one running, is
+// taken out and added again.  Returns 0 if there are already
+// SCHED_MAX_TASKS tasks.
+uint8_t taskAdd(sched_task *t, void (*run)(void *), void *arg, unsigned long period, uint8_t priority)
+{
+	taskRemove(t);
+	if (sched_waiting.count + sched_ready.count == SCHED_MAX_TASKS)
+		return 0;
+
+	t->run = run;
+	t->arg = arg;
+	t->period = period;
+	t->deadline = period;
+	t->release = millis();
+	t->priority = priority;
+	t->runs = 0;
+	t->misses = 0;
+	t->lastMicros = 0;
+	t->maxMicros = 0;
+
+	taskPush(&sched_waiting, t);
+
+	return 1;
+}
+
+// Sets how long after its release a task must finish, in milliseconds;
+// 0 means never late.
+void taskDeadline(sched_task *t, unsigned long ms)
+{
+	t->deadline = ms;
+}
+
+void taskRemove(sched_task *t)
+{
+	sched_queue *q = taskQueue(t);
+
+	if (q)
+		taskUnlink(q, t->index);
+}
+
+// Runs the highest priority task that's been released.  Returns 0 if
+// there was none to run, for main() to run loop() instead.
+uint8_t taskRun()
+{
+	sched_task *t;
+	unsigned long now, start, elapsed;
+
+	if (sched_waiting.count + sched_ready.count == 0)
+		return 0;
+
+	now = millis();
+	while (sched_waiting.count &&
+	       (long) (now - sched_waiting.task[0]->release) >= 0) {
+		t = sched_waiting.task[0];
+		taskUnlink(&sched_waiting, 0);
+		taskPush(&sched_ready, t);
+	}
+	if (sched_ready.count == 0)
+		return 0;
+
+	t = sched_ready.task[0];
+
+	start = micros();
+	t->run(t->arg);
+	elapsed = micros() - start;
+
+	t->runs++;
+	t->lastMicros = elapsed;
+	if (elapsed > t->maxMicros)
+		t->maxMicros = elapsed;
+	if (t->deadline && (long) (millis() - t->release) > (long) t->deadline)
+		t->misses++;
+
+	// the task may have removed itself
+	if (taskQueue(t) != &sched_ready)
+		return 1;
+
+	taskUnlink(&sched_ready, t->index);
+	if (t->period != 0) {
+		// drop releases we're too late for rather than running the task
+		// back to back to catch up
+		t->release += t->period;
+		if ((long) (now - t->release) >= 0)
+			t->release = now + t->period;
+		taskPush(&sched_waiting, t);
+	}
+
+	return 1;
+}
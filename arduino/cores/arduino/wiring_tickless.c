@@ -0,0 +1,145 @@
+/*
+  wiring_tickless.c - low power delay
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include <avr/sleep.h>
+
+#include "wiring_private.h"
+
+#if defined(TCCR1B) && defined(OCIE1B) && defined(TIMSK0) && defined(TIMSK1)
+
+// delay() with IDLE_SLEEP still wakes for every timer 0 overflow, about a
+// thousand times a second.  delayTickless() masks that interrupt and
+// sleeps on timer 1 instead, counting at clk/1024 to a compare match set
+// for the end of the wait (or 4.19 s at 16 MHz, whichever is sooner), and
+// afterwards credits millis() with the overflows it slept through.
+//
+// Timer 0 keeps counting in idle mode, and timers 0 and 1 share one
+// prescaler, so each timer 1 tick is exactly 16 timer 0 ticks, give or
+// take the phase of the first one.  From timer 0's count before and after
+// and the timer 1 ticks in between, the number of overflows comes out
+// exactly.
+//
+// Timer 1 is taken with timerAcquire() for the length of the call and
+// then put back as it was.  If it can't be had, because cycles(), pulse
+// capture, the ADC stream, tone() or pwm on its pins is using it, this is
+// just delay().  Compare match B wakes the CPU, leaving compare A to
+// tone().  Any other interrupt still wakes the CPU, to be handled as
+// usual, and the wait goes on.
+
+EMPTY_INTERRUPT(TIMER1_COMPB_vect);
+
+static void sleepTicks(unsigned int n)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t tccr1a, tccr1b, timsk1;
+	unsigned int ocr1b, tcnt1;
+	uint8_t t0, t1;
+	unsigned int slept;
+	long overflows = 0;
+
+	cli();
+
+	tccr1a = TCCR1A;
+	tccr1b = TCCR1B;
+	timsk1 = TIMSK1;
+	ocr1b = OCR1B;
+	tcnt1 = TCNT1;
+
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TCNT1 = 0;
+	OCR1B = n;
+	TIFR1 = _BV(OCF1B);
+	TIMSK1 = _BV(OCIE1B);
+
+	// an overflow already waiting is counted here rather than by the
+	// interrupt; stay clear of the wrap while reading the count
+	while (TCNT0 == 255)
+		;
+	t0 = TCNT0;
+	if (TIFR0 & _BV(TOV0))
+		overflows++;
+	TIFR0 = _BV(TOV0);
+	TIMSK0 &= ~_BV(TOIE0);
+
+	TCCR1B = _BV(CS12) | _BV(CS10);
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	cli();
+
+	while (TCNT0 == 255)
+		;
+	slept = TCNT1;
+	t1 = TCNT0;
+	TIFR0 = _BV(TOV0);
+
+	// t0 + 16 * slept lands within 16 ticks of the true count; the
+	// overflows are the whole number of 256s between there and t1
+	overflows += ((long) t0 + 16L * slept - t1 + 128) >> 8;
+	timer0Advance(overflows);
+	TIMSK0 |= _BV(TOIE0);
+
+	TCCR1B = 0;
+	TIMSK1 = timsk1;
+	OCR1B = ocr1b;
+	TCNT1 = tcnt1;
+	TCCR1A = tccr1a;
+	TCCR1B = tccr1b;
+
+	SREG = oldSREG;
+}
+
+// Waits ms milliseconds asleep, waking only for the end of the wait and
+// for interrupts other than timer 0's.  Interrupts must be enabled.
+void delayTickless(unsigned long ms)
+{
+	unsigned long start = millis();
+	unsigned long elapsed;
+
+	if (!timerAcquire(1, TIMER_OWNER_TICKLESS)) {
+		delay(ms);
+		return;
+	}
+
+	while ((elapsed = millis() - start) < ms) {
+		// clk/1024 ticks for what's left, minus one for the phase of
+		// the first tick so we wake early rather than late
+		unsigned long left = ms - elapsed;
+		unsigned long n = (left > 4000) ? 65535 : left * (F_CPU / 1000) / 1024;
+
+		if (n < 2) {
+			delay(ms - elapsed);
+			break;
+		}
+		if (n > 65535)
+			n = 65535;
+		sleepTicks(n - 1);
+	}
+
+	timerRelease(1, TIMER_OWNER_TICKLESS);
+}
+
+#endif
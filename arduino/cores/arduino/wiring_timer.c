@@ -0,0 +1,162 @@
+/*
+  wiring_timer.c - sharing the hardware timers
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+
+// Who is using each hardware timer.  init() sets every timer up for 8-bit
+// pwm, and that's the shared state a timer starts and ends in: its compare
+// channels can be claimed one at a time, by analogWrite() for a pin or by
+// anything else that only needs a compare register and its interrupt, but
+// the mode and prescaler must be left alone.  Something that has to
+// reprogram a timer (tone(), cycles(), pulse capture, soft pwm, the ADC
+// stream, delayTickless()) takes the whole of it, which it can only do
+// while no channel is held by anyone else, and puts it back to the init()
+// setup before releasing it.  Timer 0 always runs millis(), so its
+// channels can be claimed but the timer itself can't.
+//
+// A request that conflicts with the current owner fails, and each caller
+// has a fixed way of failing: analogWrite() falls back to a digital write,
+// tone() stays silent, the rest return 0.
+
+#if defined(TCCR5A)
+#define TIMER_COUNT 6
+#elif defined(TCCR3A)
+#define TIMER_COUNT 4
+#else
+#define TIMER_COUNT 3
+#endif
+
+#if defined(OCR1C)
+#define TIMER_CHANNELS 3
+#else
+#define TIMER_CHANNELS 2
+#endif
+
+// 0 is the shared init() setup, so both arrays start out right
+static uint8_t timer_owner[TIMER_COUNT];
+static uint8_t timer_channel_owner[TIMER_COUNT][TIMER_CHANNELS];
+
+// Takes the whole of a timer.  Succeeds if the owner has it already.
+uint8_t timerAcquire(uint8_t timer, uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t ok = 0;
+	uint8_t i;
+
+	if (timer == 0 || timer >= TIMER_COUNT || owner <= TIMER_OWNER_MILLIS)
+		return 0;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (timer_owner[timer] == owner) {
+		ok = 1;
+	} else if (timer_owner[timer] == TIMER_OWNER_NONE) {
+		for (i = 0; i < TIMER_CHANNELS; i++)
+			if (timer_channel_owner[timer][i] != TIMER_OWNER_NONE &&
+			    timer_channel_owner[timer][i] != owner)
+				break;
+		if (i == TIMER_CHANNELS) {
+			timer_owner[timer] = owner;
+			ok = 1;
+		}
+	}
+	CRITICAL_END(oldSREG);
+
+	return ok;
+}
+
+// Gives a timer back, along with any of its channels the owner holds.
+// The owner must have restored the init() setup first.
+void timerRelease(uint8_t timer, uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t i;
+
+	if (timer >= TIMER_COUNT)
+		return;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (timer_owner[timer] == owner)
+		timer_owner[timer] = TIMER_OWNER_NONE;
+	for (i = 0; i < TIMER_CHANNELS; i++)
+		if (timer_channel_owner[timer][i] == owner)
+			timer_channel_owner[timer][i] = TIMER_OWNER_NONE;
+	CRITICAL_END(oldSREG);
+}
+
+// Claims compare channel TIMER_CHANNEL_A, B or C of a timer: its output
+// compare register, its pin's compare output mode and its interrupt.
+// Possible while the timer is shared or is the owner's own.
+uint8_t timerChannelAcquire(uint8_t timer, uint8_t channel, uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t ok = 0;
+	uint8_t *c;
+
+	if (timer >= TIMER_COUNT || channel >= TIMER_CHANNELS || owner == TIMER_OWNER_NONE)
+		return 0;
+
+	c = &timer_channel_owner[timer][channel];
+
+	CRITICAL_BEGIN(oldSREG);
+	if (*c == owner) {
+		ok = 1;
+	} else if (*c == TIMER_OWNER_NONE &&
+		   (timer_owner[timer] == TIMER_OWNER_NONE || timer_owner[timer] == owner)) {
+		*c = owner;
+		ok = 1;
+	}
+	CRITICAL_END(oldSREG);
+
+	return ok;
+}
+
+void timerChannelRelease(uint8_t timer, uint8_t channel, uint8_t owner)
+{
+	uint8_t oldSREG = SREG;
+
+	if (timer >= TIMER_COUNT || channel >= TIMER_CHANNELS)
+		return;
+
+	CRITICAL_BEGIN(oldSREG);
+	if (timer_channel_owner[timer][channel] == owner)
+		timer_channel_owner[timer][channel] = TIMER_OWNER_NONE;
+	CRITICAL_END(oldSREG);
+}
+
+// The owner of a timer: TIMER_OWNER_PWM while it's shared (TIMER_OWNER_MILLIS
+// for timer 0), TIMER_OWNER_NONE if the chip doesn't have it.
+uint8_t timerOwner(uint8_t timer)
+{
+	if (timer >= TIMER_COUNT)
+		return TIMER_OWNER_NONE;
+	if (timer_owner[timer] != TIMER_OWNER_NONE)
+		return timer_owner[timer];
+	return (timer == 0) ? TIMER_OWNER_MILLIS : TIMER_OWNER_PWM;
+}
+
+uint8_t timerChannelOwner(uint8_t timer, uint8_t channel)
+{
+	if (timer >= TIMER_COUNT || channel >= TIMER_CHANNELS)
+		return TIMER_OWNER_NONE;
+	return timer_channel_owner[timer][channel];
+}
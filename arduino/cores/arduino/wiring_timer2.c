@@ -0,0 +1,57 @@
+/*
+  wiring_timer2.c - the shared timer 2 overflow interrupt
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include "wiring_private.h"
+
+#if defined(TIMER2_OVF_vect)
+
+// Soft pwm and the synth both run off timer 2's overflow interrupt, and
+// if each defined it they couldn't be linked into one sketch.  The
+// interrupt lives here instead and calls whatever the owner of timer 2
+// set with timer2Overflow(); timerAcquire() lets only one of them have
+// the timer at a time.  Going through a pointer makes the interrupt
+// save the call-used registers, about 40 cycles more per overflow than
+// a handler of its own.
+
+static void (*volatile timer2_overflow)(void);
+
+SIGNAL(TIMER2_OVF_vect)
+{
+	void (*fn)(void) = timer2_overflow;
+
+	if (fn)
+		fn();
+}
+
+// Sets the function the timer 2 overflow interrupt calls, or 0 for none.
+// Only for whoever holds timer 2 through timerAcquire().
+void timer2Overflow(void (*fn)(void))
+{
+	uint8_t oldSREG = SREG;
+
+	CRITICAL_BEGIN(oldSREG);
+	timer2_overflow = fn;
+	CRITICAL_END(oldSREG);
+}
+
+#endif
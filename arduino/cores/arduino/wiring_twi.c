@@ -0,0 +1,312 @@
+/*
+  wiring_twi.c - interrupt driven TWI (I2C) master
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#include <util/twi.h>
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+#include "wiring_twi.h"
+
+#if defined(TWCR)
+
+// The queue works like the one in wiring_spi.c: transactions are linked
+// through their own next pointers and the TWI interrupt walks each one
+// through start, address, data and stop without loop() waiting on TWINT.
+// Back-to-back transactions are joined with a combined stop and start.
+
+#define TWI_REPLY (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+
+// volatile, since twiEnd() waits on it for the interrupt to empty it
+static twi_transaction * volatile twi_head = 0;
+static twi_transaction *twi_tail = 0;
+static uint8_t twi_pos;
+static uint8_t twi_reading;
+
+// a transaction opens with a read only if that's all it does; with both
+// lengths zero it's a write of nothing, which just probes the address
+#define twiReadsFirst(t) ((t)->txLength == 0 && (t)->rxLength != 0)
+
+static void twiStart(twi_transaction *t)
+{
+	t->status = TWI_ACTIVE;
+	twi_pos = 0;
+	twi_reading = twiReadsFirst(t);
+
+	// a stop we sent a moment ago may still be on its way out
+	while (TWCR & _BV(TWSTO))
+		;
+	TWCR = TWI_REPLY | _BV(TWSTA);
+}
+
+// retires the transaction at the head of the queue with the given status;
+// called with interrupts disabled.
+static void twiFinish(uint8_t status)
+{
+	twi_transaction *t = twi_head;
+
+	twi_head = t->next;
+	if (twi_head == 0)
+		twi_tail = 0;
+	t->next = 0;
+
+	if (twi_head) {
+		// stop and start again in one go
+		twi_head->status = TWI_ACTIVE;
+		twi_pos = 0;
+		twi_reading = twiReadsFirst(twi_head);
+		TWCR = TWI_REPLY | _BV(TWSTO) | _BV(TWSTA);
+	} else {
+		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+	}
+
+	t->status = status;
+	if (t->callback)
+		t->callback(t);
+}
+
+SIGNAL(TWI_vect)
+{
+	twi_transaction *t = twi_head;
+
+	if (t == 0) {
+		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+		return;
+	}
+
+	switch (TW_STATUS) {
+	case TW_START:
+	case TW_REP_START:
+		TWDR = (t->address << 1) | (twi_reading ? TW_READ : TW_WRITE);
+		TWCR = TWI_REPLY;
+		break;
+
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (twi_pos < t->txLength) {
+			TWDR = t->txBuffer[twi_pos++];
+			TWCR = TWI_REPLY;
+		} else if (t->rxLength) {
+			twi_pos = 0;
+			twi_reading = 1;
+			TWCR = TWI_REPLY | _BV(TWSTA);
+		} else {
+			twiFinish(TWI_DONE);
+		}
+		break;
+
+	case TW_MR_SLA_ACK:
+		// acknowledge every byte but the last
+		TWCR = TWI_REPLY | (t->rxLength > 1 ? _BV(TWEA) : 0);
+		break;
+
+	case TW_MR_DATA_ACK:
+		t->rxBuffer[twi_pos++] = TWDR;
+		TWCR = TWI_REPLY | (twi_pos + 1 < t->rxLength ? _BV(TWEA) : 0);
+		break;
+
+	case TW_MR_DATA_NACK:
+		t->rxBuffer[twi_pos++] = TWDR;
+		twiFinish(TWI_DONE);
+		break;
+
+	case TW_MT_DATA_NACK:
+		// a slave may refuse the last byte of a write; only an earlier
+		// refusal is an error
+		if (twi_pos == t->txLength && t->rxLength == 0)
+			twiFinish(TWI_DONE);
+		else
+			twiFinish(TWI_NACK);
+		break;
+
+	case TW_MT_SLA_NACK:
+	case TW_MR_SLA_NACK:
+		twiFinish(TWI_NACK);
+		break;
+
+	case TW_MT_ARB_LOST:
+		// another master won; start over once the bus is free
+		twi_pos = 0;
+		twi_reading = twiReadsFirst(t);
+		TWCR = TWI_REPLY | _BV(TWSTA);
+		break;
+
+	case TW_BUS_ERROR:
+	default:
+		// a misplaced start or stop; the stop just resets the
+		// hardware, nothing goes out on the bus
+		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+		twiFinish(TWI_BUS_ERROR);
+		break;
+	}
+}
+
+// Sets up the TWI unit as a master clocking SCL at the given frequency
+// (100000 or 400000 are the standard rates) and turns on the internal
+// pull-ups, which are enough for short runs at 100 kHz only.
+void twiBegin(unsigned long frequency)
+{
+	// SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS); take the smallest
+	// prescaler that gets TWBR under 256.
+	unsigned long div = (F_CPU / frequency - 16) / 2;
+	uint8_t ps = 0;
+
+	if (F_CPU / frequency <= 16)
+		div = 0;
+	while (div > 255 && ps < 3) {
+		div >>= 2;
+		ps++;
+	}
+	if (div > 255)
+		div = 255;
+
+	digitalWrite(SDA, HIGH);
+	digitalWrite(SCL, HIGH);
+
+	TWSR = ps;
+	TWBR = div;
+	TWCR = _BV(TWEN);
+}
+
+void twiEnd()
+{
+	while (twiBusy())
+		;
+	TWCR = 0;
+}
+
+// Appends a transaction to the queue, starting it if the bus is idle.
+// Returns 0 if the transaction is already queued or running.
+uint8_t twiQueue(twi_transaction *transaction)
+{
+	uint8_t oldSREG = SREG;
+
+	if (transaction->status == TWI_QUEUED || transaction->status == TWI_ACTIVE)
+		return 0;
+
+	transaction->next = 0;
+
+	cli();
+	transaction->status = TWI_QUEUED;
+	if (twi_tail) {
+		twi_tail->next = transaction;
+		twi_tail = transaction;
+	} else {
+		twi_head = twi_tail = transaction;
+		twiStart(transaction);
+	}
+	SREG = oldSREG;
+
+	return 1;
+}
+
+uint8_t twiBusy()
+{
+	return twi_head != 0;
+}
+
+// Blocking transfer through the queue; returns the final status.  Must
+// not be called with interrupts off.
+uint8_t twiTransfer(uint8_t address, const uint8_t *txBuffer, uint8_t txLength,
+	uint8_t *rxBuffer, uint8_t rxLength)
+{
+	twi_transaction t;
+
+	t.address = address;
+	t.txBuffer = txBuffer;
+	t.txLength = txLength;
+	t.rxBuffer = rxBuffer;
+	t.rxLength = rxLength;
+	t.status = TWI_IDLE;
+	t.callback = 0;
+
+	twiQueue(&t);
+	while (t.status < TWI_DONE)
+		;
+	return t.status;
+}
+
+// Frees a bus that a slave is holding.  A slave reset in the middle of a
+// read can be left driving SDA low, waiting for clocks that will never
+// come, and the TWI unit can't issue a start until it lets go.  Call this
+// when a transaction has been active for longer than it possibly could
+// be: it fails that transaction with TWI_BUS_ERROR, clocks SCL by hand
+// until SDA is released (nine clocks at most), sends a stop and carries on
+// with the rest of the queue.
+void twiRecover()
+{
+	volatile uint8_t *sdaIn = portInputRegister(digitalPinToPort(SDA));
+	volatile uint8_t *sclMode = portModeRegister(digitalPinToPort(SCL));
+	volatile uint8_t *sdaMode = portModeRegister(digitalPinToPort(SDA));
+	uint8_t sdaMask = digitalPinToBitMask(SDA);
+	uint8_t sclMask = digitalPinToBitMask(SCL);
+	uint8_t oldSREG = SREG;
+	uint8_t i;
+
+	cli();
+
+	// take the pins back from the TWI unit.  they're driven open drain
+	// style: output low to pull down, input with pull-up to let go.
+	TWCR = 0;
+	digitalWrite(SDA, LOW);
+	digitalWrite(SCL, LOW);
+	*sdaMode &= ~sdaMask;
+	*sclMode &= ~sclMask;
+	digitalWrite(SDA, HIGH);
+	digitalWrite(SCL, HIGH);
+
+	for (i = 0; i < 9 && !(*sdaIn & sdaMask); i++) {
+		digitalWrite(SCL, LOW);
+		*sclMode |= sclMask;
+		delayMicroseconds(5);
+		*sclMode &= ~sclMask;
+		digitalWrite(SCL, HIGH);
+		delayMicroseconds(5);
+	}
+
+	// stop: SDA rises while SCL is high
+	digitalWrite(SDA, LOW);
+	*sdaMode |= sdaMask;
+	delayMicroseconds(5);
+	*sdaMode &= ~sdaMask;
+	digitalWrite(SDA, HIGH);
+	delayMicroseconds(5);
+
+	TWCR = _BV(TWEN);
+
+	if (twi_head) {
+		twi_transaction *t = twi_head;
+
+		twi_head = t->next;
+		if (twi_head == 0)
+			twi_tail = 0;
+		t->next = 0;
+		t->status = TWI_BUS_ERROR;
+		if (t->callback)
+			t->callback(t);
+		if (twi_head)
+			twiStart(twi_head);
+	}
+
+	SREG = oldSREG;
+}
+
+#endif
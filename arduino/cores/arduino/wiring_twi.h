@@ -0,0 +1,69 @@
+/*
+  wiring_twi.h - interrupt driven TWI (I2C) master
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+#ifndef WiringTWI_h
+#define WiringTWI_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// twi_transaction.status; anything from TWI_DONE up means finished
+#define TWI_IDLE 0
+#define TWI_QUEUED 1
+#define TWI_ACTIVE 2
+#define TWI_DONE 3
+#define TWI_NACK 4		// the slave didn't acknowledge its address or a byte
+#define TWI_BUS_ERROR 5		// illegal start/stop on the bus, or twiRecover()
+
+// One transfer with a 7-bit slave address: txLength bytes are written
+// from txBuffer, then, after a repeated start, rxLength bytes are read
+// into rxBuffer.  Either length may be zero, giving a plain write or a
+// plain read; with both zero, only the address goes out, to see whether
+// anything acknowledges it.  The caller owns the storage, which must
+// stay put until the status is TWI_DONE or an error.  The callback, if
+// any, runs in interrupt context.
+typedef struct twi_transaction {
+	struct twi_transaction *next;
+	uint8_t address;
+	const uint8_t *txBuffer;
+	uint8_t txLength;
+	uint8_t *rxBuffer;
+	uint8_t rxLength;
+	volatile uint8_t status;
+	void (*callback)(struct twi_transaction *);
+} twi_transaction;
+
+void twiBegin(unsigned long frequency);
+void twiEnd(void);
+uint8_t twiQueue(twi_transaction *transaction);
+uint8_t twiBusy(void);
+uint8_t twiTransfer(uint8_t address, const uint8_t *txBuffer, uint8_t txLength, uint8_t *rxBuffer, uint8_t rxLength);
+void twiRecover(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
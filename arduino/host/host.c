@@ -0,0 +1,1232 @@
+/*
+  host.c - a virtual ATmega328P for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/twi.h>
+#include "pins_arduino.h"
+#include "host.h"
+
+// The register page and SREG's page are mapped twice from one memfd:
+// __host_io, where the sketch and the core see the registers, stays
+// PROT_NONE, __host_sreg is read-only, and io, which only this file
+// uses, is always readable and writable.  An access to __host_io, or a
+// write to SREG, faults; the SIGSEGV handler brings the peripherals up
+// to date, fills in what a read should see, opens the page and
+// single-steps the instruction, and the SIGTRAP that follows closes it
+// again and acts on whatever was written.  Both handlers keep SIGALRM
+// out, so the step is never split by an interrupt.
+//
+// Time is the wall clock scaled to F_CPU, so millis() and micros() keep
+// real time however fast the host runs the sketch.  A SIGALRM every
+// HOST_TICK_US runs the interrupt handlers that are due, in vector
+// order, as the chip would; an sei(), a write to SREG or a register
+// access that lets one in raises it at once.  Anything that becomes due
+// on its own, such as a timer match, can run up to HOST_TICK_US late.
+//
+// int is 32 bits and long 64 here, not 16 and 32 as on the chip, so a
+// sketch that counts on wrapping at 16 or 32 bits sees it later.
+
+#define HOST_PAGE 4096
+#define HOST_REGS 0x100
+#define HOST_TICK_US 250
+#define HOST_EVENTS_MAX 1024
+#define HOST_PINS 20
+#define HOST_INTS 2
+#define HOST_RX_SIZE 4096
+#define HOST_TX_SIZE 4096
+
+volatile uint8_t __host_io[HOST_PAGE] __attribute__ ((aligned (HOST_PAGE)));
+volatile uint8_t __host_sreg[HOST_PAGE] __attribute__ ((aligned (HOST_PAGE)));
+volatile uint8_t *__host_sreg_rw;
+uint8_t __host_ram[RAMEND + 1];
+// avr-libc's malloc() keeps its top here; the host's doesn't
+char *__brkval;
+
+static uint8_t *io;
+static host_hook hooks[HOST_REGS];
+static struct timespec host_start;
+static unsigned long long host_limit;
+
+// the instruction being single-stepped
+static volatile uint8_t *trap_page;
+static int trap_prot;
+static unsigned int trap_addr;
+static uint8_t trap_write;
+static uint8_t trap_active;
+static uint8_t trap_alarm_blocked;
+static uint8_t trap_old[8];
+
+#define HOST_VECTOR(n) extern void __vector_ ## n(void) __attribute__ ((weak));
+HOST_VECTOR(1) HOST_VECTOR(2) HOST_VECTOR(3) HOST_VECTOR(4) HOST_VECTOR(5)
+HOST_VECTOR(6) HOST_VECTOR(7) HOST_VECTOR(8) HOST_VECTOR(9) HOST_VECTOR(10)
+HOST_VECTOR(11) HOST_VECTOR(12) HOST_VECTOR(13) HOST_VECTOR(14) HOST_VECTOR(15)
+HOST_VECTOR(16) HOST_VECTOR(17) HOST_VECTOR(18) HOST_VECTOR(19) HOST_VECTOR(20)
+HOST_VECTOR(21) HOST_VECTOR(22) HOST_VECTOR(23) HOST_VECTOR(24) HOST_VECTOR(25)
+
+static void (*const host_vectors[HOST_VECTORS])(void) = {
+	0, __vector_1, __vector_2, __vector_3, __vector_4, __vector_5,
+	__vector_6, __vector_7, __vector_8, __vector_9, __vector_10,
+	__vector_11, __vector_12, __vector_13, __vector_14, __vector_15,
+	__vector_16, __vector_17, __vector_18, __vector_19, __vector_20,
+	__vector_21, __vector_22, __vector_23, __vector_24, __vector_25,
+};
+
+#define REG(r) _SFR_MEM_ADDR(r)
+
+static void hostFail(const char *what)
+{
+	fprintf(stderr, "host: %s: %s\n", what, strerror(errno));
+	_exit(1);
+}
+
+unsigned long long hostCycles(void)
+{
+	struct timespec t;
+	long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ns = (long long) (t.tv_sec - host_start.tv_sec) * 1000000000 + t.tv_nsec - host_start.tv_nsec;
+	return (unsigned __int128) ns * F_CPU / 1000000000;
+}
+
+/* timers */
+
+// tifr and timsk bits, and the order of pending[] and vector[]
+#define HOST_TOV 0
+#define HOST_OCA 1
+#define HOST_OCB 2
+
+typedef struct {
+	uint8_t tccra, tccrb, tcnt, ocra, ocrb, icr, timsk, tifr;
+	uint8_t wide, async;
+	uint8_t vector[3];
+	unsigned long long last;	// the cycle the timer was brought up to
+	unsigned long long u;		// ticks since count 0, unfolded
+	unsigned int count;
+	unsigned int pending[3];
+} host_timer;
+
+static host_timer timers[3] = {
+	{ .tccra = REG(TCCR0A), .tccrb = REG(TCCR0B), .tcnt = REG(TCNT0),
+	  .ocra = REG(OCR0A), .ocrb = REG(OCR0B), .timsk = REG(TIMSK0), .tifr = REG(TIFR0),
+	  .vector = { TIMER0_OVF_vect_num, TIMER0_COMPA_vect_num, TIMER0_COMPB_vect_num } },
+	{ .tccra = REG(TCCR1A), .tccrb = REG(TCCR1B), .tcnt = REG(TCNT1L),
+	  .ocra = REG(OCR1AL), .ocrb = REG(OCR1BL), .icr = REG(ICR1L),
+	  .timsk = REG(TIMSK1), .tifr = REG(TIFR1), .wide = 1,
+	  .vector = { TIMER1_OVF_vect_num, TIMER1_COMPA_vect_num, TIMER1_COMPB_vect_num } },
+	{ .tccra = REG(TCCR2A), .tccrb = REG(TCCR2B), .tcnt = REG(TCNT2),
+	  .ocra = REG(OCR2A), .ocrb = REG(OCR2B), .timsk = REG(TIMSK2), .tifr = REG(TIFR2),
+	  .async = 1,
+	  .vector = { TIMER2_OVF_vect_num, TIMER2_COMPA_vect_num, TIMER2_COMPB_vect_num } },
+};
+
+static void adcTrigger(uint8_t source);
+
+static unsigned int reg16(uint8_t addr)
+{
+	return io[addr] | (io[addr + 1] << 8);
+}
+
+static unsigned int timerPrescale(host_timer *t)
+{
+	static const uint16_t sync[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	static const uint16_t async[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	uint8_t cs = io[t->tccrb] & 7;
+
+	// 6 and 7 on timers 0 and 1 count T0 and T1, which nothing drives
+	return t->async ? async[cs] : sync[cs];
+}
+
+// TOP, and whether the timer counts down again from it
+static unsigned int timerTop(host_timer *t, uint8_t *dual, uint8_t *ctc)
+{
+	uint8_t wgm;
+
+	*dual = 0;
+	*ctc = 0;
+	if (t->wide) {
+		wgm = (io[t->tccra] & 3) | ((io[t->tccrb] >> 1) & 0x0C);
+		switch (wgm) {
+		case 1: *dual = 1; return 0xFF;
+		case 2: *dual = 1; return 0x1FF;
+		case 3: *dual = 1; return 0x3FF;
+		case 4: *ctc = 1; return reg16(t->ocra);
+		case 5: return 0xFF;
+		case 6: return 0x1FF;
+		case 7: return 0x3FF;
+		case 8: case 10: *dual = 1; return reg16(t->icr);
+		case 9: case 11: *dual = 1; return reg16(t->ocra);
+		case 12: *ctc = 1; return reg16(t->icr);
+		case 14: return reg16(t->icr);
+		case 15: return reg16(t->ocra);
+		default: return 0xFFFF;
+		}
+	}
+	wgm = (io[t->tccra] & 3) | ((io[t->tccrb] >> 1) & 0x04);
+	switch (wgm) {
+	case 1: *dual = 1; return 0xFF;
+	case 2: *ctc = 1; return io[t->ocra];
+	case 3: return 0xFF;
+	case 5: *dual = 1; return io[t->ocra];
+	case 7: return io[t->ocra];
+	default: return 0xFF;
+	}
+}
+
+// how many times the count passes through phase e of a period p between
+// positions a (left out) and b (taken in)
+static unsigned long long timerHits(unsigned long long a, unsigned long long b,
+	unsigned long long e, unsigned long long p)
+{
+	return (b + p - e) / p - (a + p - e) / p;
+}
+
+static void timerPend(host_timer *t, uint8_t k, unsigned long long n)
+{
+	if (n == 0)
+		return;
+	n += t->pending[k];
+	t->pending[k] = n > HOST_EVENTS_MAX ? HOST_EVENTS_MAX : n;
+	io[t->tifr] |= _BV(k);
+}
+
+// compare matches on a channel with compare value o
+static unsigned long long timerMatches(unsigned long long a, unsigned long long b,
+	unsigned int o, unsigned int top, unsigned long long p, uint8_t dual)
+{
+	if (o > top)
+		return 0;
+	if (!dual)
+		return timerHits(a, b, o, p);
+	if (o == 0 || o == top)
+		return timerHits(a, b, o, p);
+	return timerHits(a, b, o, p) + timerHits(a, b, p - o, p);
+}
+
+static void timerRun(host_timer *t, unsigned long long now)
+{
+	unsigned int ps = timerPrescale(t);
+	unsigned long long ticks, a, b, p, v, n;
+	unsigned int top, oa, ob;
+	uint8_t dual, ctc;
+
+	if (ps == 0 || now <= t->last) {
+		t->last = now;
+		return;
+	}
+	ticks = (now - t->last) / ps;
+	if (ticks == 0)
+		return;
+	t->last += ticks * ps;
+
+	top = timerTop(t, &dual, &ctc);
+	p = dual ? 2 * (unsigned long long) top : top + 1ULL;
+	if (p == 0)
+		p = 1;
+	a = t->u;
+	b = a + ticks;
+
+	oa = t->wide ? reg16(t->ocra) : io[t->ocra];
+	ob = t->wide ? reg16(t->ocrb) : io[t->ocrb];
+	// in CTC the counter only overflows if TOP is MAX; that's left out
+	if (!ctc) {
+		n = timerHits(a, b, 0, p);
+		timerPend(t, HOST_TOV, n);
+		if (n && t == &timers[0])
+			adcTrigger(4);
+		if (n && t == &timers[1])
+			adcTrigger(6);
+	}
+	n = timerMatches(a, b, oa, top, p, dual);
+	timerPend(t, HOST_OCA, n);
+	if (n && t == &timers[0])
+		adcTrigger(3);
+	n = timerMatches(a, b, ob, top, p, dual);
+	timerPend(t, HOST_OCB, n);
+	if (n && t == &timers[1])
+		adcTrigger(5);
+
+	v = b % p;
+	t->u = v;
+	t->count = dual && v > top ? p - v : v;
+}
+
+static host_timer *timerAt(unsigned int addr)
+{
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		host_timer *t = &timers[i];
+		uint8_t w = t->wide;
+
+		if (addr == t->tccra || addr == t->tccrb
+		    || addr == t->tcnt || (w && addr == t->tcnt + 1u)
+		    || addr == t->ocra || (w && addr == t->ocra + 1u)
+		    || addr == t->ocrb || (w && addr == t->ocrb + 1u)
+		    || (w && (addr == t->icr || addr == t->icr + 1u)))
+			return t;
+	}
+	return 0;
+}
+
+static void timerRead(host_timer *t, unsigned int addr)
+{
+	if (addr == t->tcnt || addr == t->tcnt + 1u) {
+		io[t->tcnt] = t->count;
+		if (t->wide)
+			io[t->tcnt + 1] = t->count >> 8;
+	}
+}
+
+static void timerWrite(host_timer *t, unsigned int addr)
+{
+	if (addr == t->tcnt || addr == t->tcnt + 1u)
+		t->count = t->wide ? reg16(t->tcnt) : io[t->tcnt];
+	// carry on from the same count under whatever the new settings are
+	t->u = t->count;
+}
+
+/* ports */
+
+static uint8_t pin_input[HOST_PINS];
+static uint8_t pin_reported[HOST_PINS];
+static void (*pin_fn)(uint8_t pin, uint8_t level);
+
+// PINx for a port, with DDRx and PORTx just after it
+static uint8_t portBase(uint8_t port)
+{
+	return pgm_read_word(port_to_input_PGM + port);
+}
+
+static uint8_t pinLevel(uint8_t pin)
+{
+	uint8_t base = portBase(digitalPinToPort(pin));
+	uint8_t bit = digitalPinToBitMask(pin);
+
+	if (io[base + 1] & bit)
+		return (io[base + 2] & bit) != 0;
+	if (pin_input[pin] == HOST_FLOATING)
+		return (io[base + 2] & bit) != 0;
+	return pin_input[pin];
+}
+
+// PINx as it would read now
+static void portRead(uint8_t base)
+{
+	uint8_t value = 0, pin;
+
+	for (pin = 0; pin < HOST_PINS; pin++)
+		if (portBase(digitalPinToPort(pin)) == base && pinLevel(pin))
+			value |= digitalPinToBitMask(pin);
+	io[base] = value;
+}
+
+static void portReport(uint8_t base)
+{
+	uint8_t pin, bit, level;
+
+	for (pin = 0; pin < HOST_PINS; pin++) {
+		if (portBase(digitalPinToPort(pin)) != base)
+			continue;
+		bit = digitalPinToBitMask(pin);
+		level = io[base + 1] & bit ? (io[base + 2] & bit) != 0 : HOST_INPUT;
+		if (level != pin_reported[pin]) {
+			pin_reported[pin] = level;
+			if (pin_fn)
+				pin_fn(pin, level);
+		}
+	}
+}
+
+// flags INTn for a change on its pin, as EICRA asks
+static void portEdge(uint8_t pin, uint8_t was, uint8_t now)
+{
+	uint8_t n, sense;
+
+	for (n = 0; n < HOST_INTS; n++) {
+		if (interruptToDigitalPin(n) != pin)
+			continue;
+		sense = (io[REG(EICRA)] >> (2 * n)) & 3;
+		if ((sense == 1 && was != now) || (sense == 2 && was && !now)
+		    || (sense == 3 && !was && now))
+			io[REG(EIFR)] |= _BV(n);
+	}
+}
+
+/* usart 0 */
+
+static uint8_t rx_buf[HOST_RX_SIZE];
+static unsigned int rx_head, rx_tail;
+static unsigned long long rx_next;
+static uint8_t rx_eof;
+static uint8_t tx_buf[HOST_TX_SIZE];
+static unsigned int tx_len;
+static void (*tx_fn)(uint8_t c);
+
+static void serialFlush(void)
+{
+	unsigned int done = 0;
+	ssize_t n;
+
+	while (done < tx_len) {
+		n = write(1, tx_buf + done, tx_len - done);
+		if (n <= 0 && errno != EINTR)
+			break;
+		if (n > 0)
+			done += n;
+	}
+	tx_len = 0;
+}
+
+// cycles for one character at the current baud rate, 8N1
+static unsigned long long serialCharCycles(void)
+{
+	unsigned int ubrr = io[REG(UBRR0L)] | ((io[REG(UBRR0H)] & 0x0F) << 8);
+
+	return 10ULL * (io[REG(UCSR0A)] & _BV(U2X0) ? 8 : 16) * (ubrr + 1);
+}
+
+static void serialPush(const uint8_t *data, unsigned int n)
+{
+	while (n--) {
+		unsigned int i = (rx_head + 1) % HOST_RX_SIZE;
+
+		if (i == rx_tail)
+			break;
+		rx_buf[rx_head] = *data++;
+		rx_head = i;
+	}
+}
+
+static void serialPoll(void)
+{
+	struct pollfd p = { 0, POLLIN, 0 };
+	uint8_t buf[256];
+	ssize_t n;
+
+	if (rx_eof || !(io[REG(UCSR0B)] & _BV(RXEN0)))
+		return;
+	if (poll(&p, 1, 0) <= 0 || !(p.revents & (POLLIN | POLLHUP)))
+		return;
+	n = read(0, buf, sizeof(buf));
+	if (n <= 0)
+		rx_eof = 1;
+	else
+		serialPush(buf, n);
+}
+
+static void serialRun(unsigned long long now)
+{
+	if (!(io[REG(UCSR0B)] & _BV(RXEN0)) || (io[REG(UCSR0A)] & _BV(RXC0))
+	    || rx_head == rx_tail || now < rx_next)
+		return;
+	io[REG(UDR0)] = rx_buf[rx_tail];
+	rx_tail = (rx_tail + 1) % HOST_RX_SIZE;
+	io[REG(UCSR0A)] |= _BV(RXC0);
+	rx_next = now + serialCharCycles();
+}
+
+static void serialSend(uint8_t c)
+{
+	if (!(io[REG(UCSR0B)] & _BV(TXEN0)))
+		return;
+	if (tx_fn) {
+		tx_fn(c);
+	} else {
+		tx_buf[tx_len++] = c;
+		if (c == '\n' || tx_len == HOST_TX_SIZE)
+			serialFlush();
+	}
+	io[REG(UCSR0A)] |= _BV(TXC0);
+}
+
+/* adc */
+
+static unsigned int adc_value[16];
+static unsigned int (*adc_fn)(uint8_t channel);
+static uint8_t adc_busy, adc_first = 1;
+static unsigned long long adc_done, adc_now;
+
+static void adcStart(unsigned long long now, uint8_t cycles)
+{
+	uint8_t ps = io[REG(ADCSRA)] & 7;
+
+	adc_busy = 1;
+	adc_done = now + (unsigned long long) cycles * (ps ? 1 << ps : 2);
+	io[REG(ADCSRA)] |= _BV(ADSC);
+}
+
+static void adcTrigger(uint8_t source)
+{
+	uint8_t a = io[REG(ADCSRA)];
+
+	if (!adc_busy && (a & _BV(ADEN)) && (a & _BV(ADATE))
+	    && (io[REG(ADCSRB)] & 7) == source)
+		adcStart(adc_now, 13);
+}
+
+static void adcRun(unsigned long long now)
+{
+	uint8_t channel = io[REG(ADMUX)] & 0x0F;
+	unsigned int value;
+
+	adc_now = now;
+	if (!adc_busy || now < adc_done)
+		return;
+	value = adc_fn ? adc_fn(channel) : adc_value[channel];
+	if (value > 1023)
+		value = 1023;
+	if (io[REG(ADMUX)] & _BV(ADLAR))
+		value <<= 6;
+	io[REG(ADCL)] = value;
+	io[REG(ADCH)] = value >> 8;
+	io[REG(ADCSRA)] |= _BV(ADIF);
+	adc_first = 0;
+	adc_busy = 0;
+	io[REG(ADCSRA)] &= ~_BV(ADSC);
+	if ((io[REG(ADCSRA)] & _BV(ADATE)) && (io[REG(ADCSRB)] & 7) == 0)
+		adcStart(adc_done > now ? adc_done : now, 13);
+}
+
+static void adcWrite(uint8_t old)
+{
+	uint8_t w = io[REG(ADCSRA)];
+	uint8_t a = (w & ~(_BV(ADIF) | _BV(ADSC))) | (old & _BV(ADIF) & ~w) | (old & _BV(ADSC));
+
+	io[REG(ADCSRA)] = a;
+	if (!(a & _BV(ADEN))) {
+		adc_busy = 0;
+		adc_first = 1;
+		io[REG(ADCSRA)] &= ~_BV(ADSC);
+	} else if ((w & _BV(ADSC)) && !adc_busy) {
+		adcStart(adc_now, adc_first ? 25 : 13);
+	}
+}
+
+/* spi */
+
+static uint8_t (*spi_fn)(uint8_t c);
+static uint8_t spi_busy, spi_in, spi_seen;
+static unsigned long long spi_done, spi_now;
+
+// cycles for one byte at the clock SPCR and SPSR select: F_CPU / 4, 16,
+// 64 or 128, or twice that with SPI2X
+static unsigned long long spiByteCycles(void)
+{
+	static const uint8_t shift[] = { 2, 4, 6, 7 };
+	uint8_t n = shift[io[REG(SPCR)] & (_BV(SPR1) | _BV(SPR0))];
+
+	if (io[REG(SPSR)] & _BV(SPI2X))
+		n--;
+	return 8ULL << n;
+}
+
+static void spiRun(unsigned long long now)
+{
+	spi_now = now;
+	if (!spi_busy || now < spi_done)
+		return;
+	io[REG(SPDR)] = spi_in;
+	io[REG(SPSR)] |= _BV(SPIF);
+	spi_busy = 0;
+}
+
+// as on the chip, SPIF and WCOL clear when SPDR is read or written after
+// SPSR has been read with SPIF set
+static void spiAccess(void)
+{
+	if (spi_seen)
+		io[REG(SPSR)] &= ~(_BV(SPIF) | _BV(WCOL));
+	spi_seen = 0;
+}
+
+// a write to SPDR: the byte goes out, if the bus is free, and whatever
+// hostOnSpi() says comes back in its place; reads of SPDR get the last
+// byte in until then
+static void spiWrite(uint8_t old)
+{
+	uint8_t w = io[REG(SPDR)];
+
+	io[REG(SPDR)] = old;
+	spiAccess();
+	if (!(io[REG(SPCR)] & _BV(SPE)))
+		return;
+	if (spi_busy) {
+		io[REG(SPSR)] |= _BV(WCOL);
+		return;
+	}
+	spi_in = spi_fn ? spi_fn(w) : 0xFF;
+	spi_busy = 1;
+	spi_done = spi_now + spiByteCycles();
+}
+
+/* twi */
+
+// The TWI unit as a master, talking to one slave that answers through
+// hostOnTwi() for every address.  Each step the sketch asks for by
+// writing TWINT takes as long as it would on the wire, and then sets
+// TWINT with the status the chip would report.  A start waits while
+// something holds SDA low, as the chip's does for a busy bus.
+
+#define TWI_HOST_IDLE 0		// no start on the bus, or a stop since
+#define TWI_HOST_START 1	// start sent; the address goes next
+#define TWI_HOST_WRITE 2	// slave acknowledged SLA+W
+#define TWI_HOST_READ 3		// slave acknowledged SLA+R
+#define TWI_HOST_STUCK 4	// a NACK, so only a start or stop is useful
+
+static uint8_t (*twi_fn)(uint8_t event, uint8_t c);
+static uint8_t twi_state, twi_busy, twi_status, twi_in, twi_starting;
+static unsigned long long twi_done, twi_now;
+
+// cycles for one SCL period: F_CPU / (16 + 2 * TWBR * 4^TWPS)
+static unsigned long long twiBitCycles(void)
+{
+	return 16 + 2ULL * io[REG(TWBR)] * (1 << (2 * (io[REG(TWSR)] & 3)));
+}
+
+static uint8_t twiSlave(uint8_t event, uint8_t c)
+{
+	if (twi_fn)
+		return twi_fn(event, c);
+	return event == HOST_TWI_READ ? 0xFF : 0;
+}
+
+static void twiRun(unsigned long long now)
+{
+	twi_now = now;
+	if (!twi_busy || now < twi_done)
+		return;
+	if (twi_starting && !pinLevel(SDA)) {
+		twi_done = now + twiBitCycles();
+		return;
+	}
+	if (twi_starting)
+		twi_state = TWI_HOST_START;
+	twi_starting = 0;
+	twi_busy = 0;
+	if (twi_status == TW_MR_DATA_ACK || twi_status == TW_MR_DATA_NACK)
+		io[REG(TWDR)] = twi_in;
+	io[REG(TWSR)] = twi_status | (io[REG(TWSR)] & 3);
+	io[REG(TWCR)] |= _BV(TWINT);
+}
+
+static void twiStep(uint8_t status, unsigned int bits)
+{
+	twi_status = status;
+	twi_busy = 1;
+	twi_done = twi_now + bits * twiBitCycles();
+}
+
+// a write to TWCR: writing TWINT clears it and starts the next step, a
+// stop goes out at once, and clearing TWEN drops everything
+static void twiWrite(uint8_t old)
+{
+	uint8_t w = io[REG(TWCR)];
+	uint8_t c = io[REG(TWDR)];
+
+	io[REG(TWCR)] = (w & ~_BV(TWINT)) | (old & _BV(TWINT) & ~w);
+	if (!(w & _BV(TWEN))) {
+		if (twi_state != TWI_HOST_IDLE)
+			twiSlave(HOST_TWI_STOP, 0);
+		twi_state = TWI_HOST_IDLE;
+		twi_busy = twi_starting = 0;
+		io[REG(TWCR)] &= ~(_BV(TWINT) | _BV(TWSTA) | _BV(TWSTO));
+		io[REG(TWSR)] = TW_NO_INFO | (io[REG(TWSR)] & 3);
+		return;
+	}
+	if (!(w & _BV(TWINT)) || twi_busy)
+		return;
+
+	io[REG(TWSR)] = TW_NO_INFO | (io[REG(TWSR)] & 3);
+	if (w & _BV(TWSTO)) {
+		if (twi_state != TWI_HOST_IDLE)
+			twiSlave(HOST_TWI_STOP, 0);
+		twi_state = TWI_HOST_IDLE;
+		io[REG(TWCR)] &= ~_BV(TWSTO);
+	}
+	if (w & _BV(TWSTA)) {
+		twiStep(twi_state == TWI_HOST_IDLE ? TW_START : TW_REP_START, 1);
+		twi_starting = 1;
+		return;
+	}
+
+	switch (twi_state) {
+	case TWI_HOST_START:
+		if (c & TW_READ) {
+			twi_state = twiSlave(HOST_TWI_ADDRESS, c) ? TWI_HOST_READ : TWI_HOST_STUCK;
+			twiStep(twi_state == TWI_HOST_READ ? TW_MR_SLA_ACK : TW_MR_SLA_NACK, 9);
+		} else {
+			twi_state = twiSlave(HOST_TWI_ADDRESS, c) ? TWI_HOST_WRITE : TWI_HOST_STUCK;
+			twiStep(twi_state == TWI_HOST_WRITE ? TW_MT_SLA_ACK : TW_MT_SLA_NACK, 9);
+		}
+		break;
+	case TWI_HOST_WRITE:
+		if (!twiSlave(HOST_TWI_WRITE, c))
+			twi_state = TWI_HOST_STUCK;
+		twiStep(twi_state == TWI_HOST_WRITE ? TW_MT_DATA_ACK : TW_MT_DATA_NACK, 9);
+		break;
+	case TWI_HOST_READ:
+		twi_in = twiSlave(HOST_TWI_READ, (w & _BV(TWEA)) != 0);
+		if (!(w & _BV(TWEA)))
+			twi_state = TWI_HOST_STUCK;
+		twiStep(w & _BV(TWEA) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK, 9);
+		break;
+	}
+}
+
+/* the engine */
+
+// Brings the peripherals up to now.  With interrupts off, a timer only
+// moves when its count is read (which then has a bit set for it), so a
+// count and the flags read after it agree, as they would a cycle apart on
+// the chip; micros() counts on that.
+static void hostRun(unsigned long long now, uint8_t which)
+{
+	uint8_t i;
+
+	adc_now = now;
+	for (i = 0; i < 3; i++)
+		if ((*__host_sreg_rw & _BV(SREG_I)) || (which & _BV(i)))
+			timerRun(&timers[i], now);
+	serialRun(now);
+	adcRun(now);
+	spiRun(now);
+	twiRun(now);
+}
+
+// the highest priority interrupt that's due, or 0
+static uint8_t hostPending(void)
+{
+	uint8_t n, k, v, best = 0;
+
+	for (n = 0; n < HOST_INTS; n++) {
+		if (!(io[REG(EIMSK)] & _BV(n)))
+			continue;
+		if ((io[REG(EIFR)] & _BV(n))
+		    || (((io[REG(EICRA)] >> (2 * n)) & 3) == 0 && !pinLevel(interruptToDigitalPin(n))))
+			return INT0_vect_num + n;
+	}
+	for (n = 0; n < 3; n++)
+		for (k = 0; k < 3; k++) {
+			v = timers[n].vector[k];
+			if ((io[timers[n].tifr] & io[timers[n].timsk] & _BV(k)) && (best == 0 || v < best))
+				best = v;
+		}
+	if (best)
+		return best;
+	if ((io[REG(SPSR)] & _BV(SPIF)) && (io[REG(SPCR)] & _BV(SPIE)))
+		return SPI_STC_vect_num;
+	if ((io[REG(UCSR0A)] & _BV(RXC0)) && (io[REG(UCSR0B)] & _BV(RXCIE0)))
+		return USART_RX_vect_num;
+	if ((io[REG(UCSR0A)] & _BV(UDRE0)) && (io[REG(UCSR0B)] & _BV(UDRIE0)))
+		return USART_UDRE_vect_num;
+	if ((io[REG(UCSR0A)] & _BV(TXC0)) && (io[REG(UCSR0B)] & _BV(TXCIE0)))
+		return USART_TX_vect_num;
+	if ((io[REG(ADCSRA)] & _BV(ADIF)) && (io[REG(ADCSRA)] & _BV(ADIE)))
+		return ADC_vect_num;
+	// TWINT stays set until the handler writes it
+	if ((io[REG(TWCR)] & _BV(TWINT)) && (io[REG(TWCR)] & _BV(TWIE)))
+		return TWI_vect_num;
+	return 0;
+}
+
+// clears the flag that entering the handler clears on the chip
+static void hostAcknowledge(uint8_t v)
+{
+	uint8_t n, k;
+
+	if (v >= INT0_vect_num && v < INT0_vect_num + HOST_INTS)
+		io[REG(EIFR)] &= ~_BV(v - INT0_vect_num);
+	for (n = 0; n < 3; n++)
+		for (k = 0; k < 3; k++)
+			if (timers[n].vector[k] == v && --timers[n].pending[k] == 0)
+				io[timers[n].tifr] &= ~_BV(k);
+	if (v == SPI_STC_vect_num)
+		io[REG(SPSR)] &= ~_BV(SPIF);
+	if (v == USART_TX_vect_num)
+		io[REG(UCSR0A)] &= ~_BV(TXC0);
+	if (v == ADC_vect_num)
+		io[REG(ADCSRA)] &= ~_BV(ADIF);
+}
+
+static void hostDispatch(void)
+{
+	uint8_t v;
+
+	while ((*__host_sreg_rw & _BV(SREG_I)) && (v = hostPending())) {
+		if (host_vectors[v] == 0) {
+			serialFlush();
+			fprintf(stderr, "host: interrupt %u is enabled but has no handler\n", v);
+			_exit(1);
+		}
+		hostAcknowledge(v);
+		*__host_sreg_rw &= ~_BV(SREG_I);
+		host_vectors[v]();
+		*__host_sreg_rw |= _BV(SREG_I);
+	}
+}
+
+static void hostTick(int sig)
+{
+	unsigned long long now = hostCycles();
+	int e = errno;
+
+	(void) sig;
+	if (host_limit && now >= host_limit)
+		hostExit(0);
+	serialPoll();
+	hostRun(now, 0);
+	hostDispatch();
+	if (tx_len)
+		serialFlush();
+	errno = e;
+}
+
+static void hostReadHook(unsigned int a)
+{
+	host_timer *t = timerAt(a);
+
+	if (t)
+		timerRead(t, a);
+	else if (a == REG(PINB) || a == REG(PINC) || a == REG(PIND))
+		portRead(a);
+	else if (a == REG(UDR0))
+		io[REG(UCSR0A)] &= ~_BV(RXC0);
+	else if (a == REG(SPSR))
+		spi_seen = (io[a] & _BV(SPIF)) != 0;
+	else if (a == REG(SPDR))
+		spiAccess();
+	if (hooks[a])
+		io[a] = hooks[a](a, io[a], 0);
+}
+
+static void hostWriteHook(unsigned int a, uint8_t old)
+{
+	host_timer *t = timerAt(a);
+	uint8_t w = io[a], pin, was[HOST_PINS];
+
+	if (t) {
+		timerWrite(t, a);
+	} else if (a == REG(TIFR0) || a == REG(TIFR1) || a == REG(TIFR2)) {
+		io[a] = old & ~w;
+		for (t = timers; t < timers + 3; t++)
+			if (t->tifr == a) {
+				uint8_t k;
+
+				for (k = 0; k < 3; k++)
+					if (w & _BV(k))
+						t->pending[k] = 0;
+			}
+	} else if (a == REG(EIFR) || a == REG(PCIFR)) {
+		io[a] = old & ~w;
+	} else if (a == REG(PINB) || a == REG(PINC) || a == REG(PIND)) {
+		for (pin = 0; pin < HOST_PINS; pin++)
+			was[pin] = pinLevel(pin);
+		io[a + 2] ^= w;
+		for (pin = 0; pin < HOST_PINS; pin++)
+			portEdge(pin, was[pin], pinLevel(pin));
+		portReport(a);
+		portRead(a);
+	} else if (a == REG(DDRB) || a == REG(DDRC) || a == REG(DDRD)
+	    || a == REG(PORTB) || a == REG(PORTC) || a == REG(PORTD)) {
+		portReport(a - (a - REG(PINB)) % 3);
+	} else if (a == REG(UDR0)) {
+		// the transmit buffer; reads still get the last byte received
+		io[a] = old;
+		serialSend(w);
+	} else if (a == REG(UCSR0A)) {
+		io[a] = (old & (_BV(RXC0) | _BV(UDRE0) | _BV(FE0) | _BV(DOR0) | _BV(UPE0)))
+			| (old & _BV(TXC0) & ~w) | (w & (_BV(U2X0) | _BV(MPCM0)));
+	} else if (a == REG(ADCSRA)) {
+		adcWrite(old);
+	} else if (a == REG(SPSR)) {
+		io[a] = (old & (_BV(SPIF) | _BV(WCOL))) | (w & _BV(SPI2X));
+	} else if (a == REG(SPDR)) {
+		spiWrite(old);
+	} else if (a == REG(TWSR)) {
+		io[a] = (old & TW_STATUS_MASK) | (w & (_BV(TWPS1) | _BV(TWPS0)));
+	} else if (a == REG(TWCR)) {
+		twiWrite(old);
+	}
+	if (hooks[a])
+		io[a] = hooks[a](a, io[a], 1);
+}
+
+static void hostFault(int sig, siginfo_t *si, void *context)
+{
+	ucontext_t *uc = context;
+	uintptr_t a = (uintptr_t) si->si_addr - (uintptr_t) __host_io;
+	host_timer *t;
+	unsigned int i;
+
+	(void) sig;
+	if (trap_active) {
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+	if ((uintptr_t) si->si_addr - (uintptr_t) __host_sreg < HOST_PAGE) {
+		// a write to SREG; hostStep() sees to the interrupts
+		trap_page = __host_sreg;
+		trap_prot = PROT_READ;
+		trap_write = 0;
+	} else if (a < HOST_PAGE) {
+		trap_page = __host_io;
+		trap_prot = PROT_NONE;
+		trap_addr = a;
+		trap_write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+		t = trap_write ? 0 : timerAt(a);
+		hostRun(hostCycles(), t && (a == t->tcnt || a == t->tcnt + 1u) ? _BV(t - timers) : 0);
+		if (!trap_write && a < HOST_REGS)
+			hostReadHook(a);
+		for (i = 0; i < sizeof(trap_old); i++)
+			trap_old[i] = a + i < HOST_PAGE ? io[a + i] : 0;
+	} else {
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	trap_alarm_blocked = sigismember(&uc->uc_sigmask, SIGALRM);
+	sigaddset(&uc->uc_sigmask, SIGALRM);
+	if (mprotect((void *) trap_page, HOST_PAGE, PROT_READ | PROT_WRITE) < 0)
+		hostFail("mprotect");
+	uc->uc_mcontext.gregs[REG_EFL] |= 0x100;
+	trap_active = 1;
+}
+
+static void hostStep(int sig, siginfo_t *si, void *context)
+{
+	ucontext_t *uc = context;
+	unsigned int i, a;
+
+	(void) sig;
+	(void) si;
+	if (!trap_active) {
+		signal(SIGTRAP, SIG_DFL);
+		raise(SIGTRAP);
+		return;
+	}
+	uc->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+	if (mprotect((void *) trap_page, HOST_PAGE, trap_prot) < 0)
+		hostFail("mprotect");
+	trap_active = 0;
+
+	// a wide store shows up as every byte it changed
+	if (trap_write)
+		for (i = 0; i < sizeof(trap_old); i++) {
+			a = trap_addr + i;
+			if (a >= HOST_REGS)
+				break;
+			if (i == 0 || io[a] != trap_old[i])
+				hostWriteHook(a, trap_old[i]);
+		}
+
+	if (!trap_alarm_blocked) {
+		sigdelset(&uc->uc_sigmask, SIGALRM);
+		if ((*__host_sreg_rw & _BV(SREG_I)) && hostPending())
+			raise(SIGALRM);
+	}
+}
+
+/* the api */
+
+static void hostBlock(sigset_t *old)
+{
+	sigset_t s;
+
+	sigemptyset(&s);
+	sigaddset(&s, SIGALRM);
+	sigprocmask(SIG_BLOCK, &s, old);
+}
+
+static void hostUnblock(sigset_t *old)
+{
+	uint8_t due = (*__host_sreg_rw & _BV(SREG_I)) && hostPending();
+
+	sigprocmask(SIG_SETMASK, old, 0);
+	if (due)
+		raise(SIGALRM);
+}
+
+void hostSei(void)
+{
+	*__host_sreg_rw |= _BV(SREG_I);
+	if (hostPending())
+		raise(SIGALRM);
+}
+
+// waits for the next tick; with interrupts off nothing could wake the
+// chip, so it doesn't wait at all
+void hostSleep(void)
+{
+	sigset_t s;
+
+	if (!(*__host_sreg_rw & _BV(SREG_I)))
+		return;
+	sigprocmask(SIG_SETMASK, 0, &s);
+	sigdelset(&s, SIGALRM);
+	sigsuspend(&s);
+}
+
+void _delay_us(double us)
+{
+	unsigned long long end = hostCycles() + (unsigned long long) (us * (F_CPU / 1000000.0));
+
+	while (hostCycles() < end)
+		;
+}
+
+void _delay_ms(double ms)
+{
+	_delay_us(ms * 1000.0);
+}
+
+host_hook hostHook(uint16_t addr, host_hook fn)
+{
+	host_hook old;
+
+	if (addr >= HOST_REGS)
+		return 0;
+	old = hooks[addr];
+	hooks[addr] = fn;
+	return old;
+}
+
+uint8_t hostRead(uint16_t addr)
+{
+	return addr < HOST_PAGE ? io[addr] : 0;
+}
+
+void hostWrite(uint16_t addr, uint8_t value)
+{
+	if (addr < HOST_PAGE)
+		io[addr] = value;
+}
+
+// drives an input pin to 0 or 1, or lets it float
+void hostPinInput(uint8_t pin, uint8_t level)
+{
+	sigset_t s;
+	uint8_t was;
+
+	if (pin >= HOST_PINS)
+		return;
+	hostBlock(&s);
+	hostRun(hostCycles(), 0);
+	was = pinLevel(pin);
+	pin_input[pin] = level;
+	portEdge(pin, was, pinLevel(pin));
+	hostUnblock(&s);
+}
+
+// what the pin is at: its output, or what drives it as an input
+uint8_t hostPinLevel(uint8_t pin)
+{
+	return pin < HOST_PINS ? pinLevel(pin) : 0;
+}
+
+// fn(pin, level) whenever a pin's output changes, with level 0 or 1, or
+// HOST_INPUT when it stops being an output
+void hostOnPin(void (*fn)(uint8_t pin, uint8_t level))
+{
+	pin_fn = fn;
+}
+
+void hostAnalogInput(uint8_t channel, unsigned int value)
+{
+	if (channel < 16)
+		adc_value[channel] = value;
+}
+
+void hostOnAnalog(unsigned int (*fn)(uint8_t channel))
+{
+	adc_fn = fn;
+}
+
+// queues bytes for USART0 to receive, as well as anything on stdin
+void hostSerialInput(const void *data, unsigned int n)
+{
+	sigset_t s;
+
+	hostBlock(&s);
+	serialPush(data, n);
+	hostUnblock(&s);
+}
+
+// fn(c) for each byte USART0 sends, instead of writing it to stdout
+void hostOnSerial(void (*fn)(uint8_t c))
+{
+	tx_fn = fn;
+}
+
+// fn(c) for each byte SPI sends, returning the byte clocked in at the
+// same time; without one, MISO reads as all ones
+void hostOnSpi(uint8_t (*fn)(uint8_t c))
+{
+	spi_fn = fn;
+}
+
+// fn(event, c) for what the TWI slave sees: HOST_TWI_ADDRESS with the
+// address byte after a start, and HOST_TWI_WRITE with each byte written,
+// returning nonzero to acknowledge; HOST_TWI_READ, with c nonzero if the
+// master will acknowledge, returning the byte to send; HOST_TWI_STOP.
+// Without one, no address is acknowledged.
+void hostOnTwi(uint8_t (*fn)(uint8_t event, uint8_t c))
+{
+	twi_fn = fn;
+}
+
+void hostExit(int status)
+{
+	serialFlush();
+	fflush(stdout);
+	_exit(status);
+}
+
+/* avr-libc's stdlib additions */
+
+char *ultoa(unsigned long value, char *s, int radix)
+{
+	char buf[8 * sizeof(value) + 1];
+	char *p = buf;
+	char *q = s;
+
+	if (radix < 2 || radix > 36) {
+		*s = 0;
+		return s;
+	}
+	do {
+		unsigned d = value % radix;
+
+		*p++ = d < 10 ? '0' + d : 'a' + d - 10;
+		value /= radix;
+	} while (value);
+	while (p > buf)
+		*q++ = *--p;
+	*q = 0;
+	return s;
+}
+
+char *ltoa(long value, char *s, int radix)
+{
+	if (radix == 10 && value < 0) {
+		*s = '-';
+		ultoa(-(unsigned long) value, s + 1, radix);
+		return s;
+	}
+	return ultoa((unsigned long) value, s, radix);
+}
+
+char *utoa(unsigned int value, char *s, int radix)
+{
+	return ultoa(value, s, radix);
+}
+
+char *itoa(int value, char *s, int radix)
+{
+	if (radix == 10 && value < 0) {
+		*s = '-';
+		ultoa(-(unsigned int) value, s + 1, radix);
+		return s;
+	}
+	return ultoa((unsigned int) value, s, radix);
+}
+
+char *dtostrf(double value, signed char width, unsigned char prec, char *s)
+{
+	sprintf(s, "%*.*f", width, prec, value);
+	return s;
+}
+
+/* start up */
+
+// runs before any constructor in the sketch or the core; takes -t
+// seconds from the command line as a limit on the run
+static void hostStart(int argc, char **argv)
+	__attribute__ ((constructor (101)));
+static void hostStart(int argc, char **argv)
+{
+	struct sigaction sa;
+	struct itimerval tick = { { 0, HOST_TICK_US }, { 0, HOST_TICK_US } };
+	int fd, i;
+	uint8_t pin;
+
+	clock_gettime(CLOCK_MONOTONIC, &host_start);
+	for (i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], "-t") == 0)
+			host_limit = (unsigned long long) (atof(argv[i + 1]) * F_CPU);
+
+	fd = memfd_create("avr-io", 0);
+	if (fd < 0 || ftruncate(fd, 2 * HOST_PAGE) < 0)
+		hostFail("memfd");
+	io = mmap(0, 2 * HOST_PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (io == MAP_FAILED)
+		hostFail("mmap");
+	if (mmap((void *) __host_io, HOST_PAGE, PROT_NONE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+	    || mmap((void *) __host_sreg, HOST_PAGE, PROT_READ, MAP_SHARED | MAP_FIXED, fd, HOST_PAGE) == MAP_FAILED)
+		hostFail("mmap");
+	close(fd);
+	__host_sreg_rw = io + HOST_PAGE;
+
+	// the reset values that aren't 0
+	io[REG(UCSR0A)] = _BV(UDRE0);
+	io[REG(UCSR0C)] = _BV(UCSZ01) | _BV(UCSZ00);
+	io[REG(TWSR)] = TW_NO_INFO;
+	io[REG(TWDR)] = 0xFF;
+	for (pin = 0; pin < HOST_PINS; pin++) {
+		pin_input[pin] = HOST_FLOATING;
+		pin_reported[pin] = HOST_INPUT;
+	}
+	adc_value[8] = 352;	// the temperature sensor at about 25C
+	adc_value[14] = 225;	// 1.1V against 5V
+	setvbuf(stdout, 0, _IOLBF, 0);
+	atexit(serialFlush);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	sigaddset(&sa.sa_mask, SIGALRM);
+	sa.sa_sigaction = hostFault;
+	sigaction(SIGSEGV, &sa, 0);
+	sa.sa_sigaction = hostStep;
+	sigaction(SIGTRAP, &sa, 0);
+
+	sa.sa_flags = SA_RESTART;
+	sa.sa_handler = hostTick;
+	sigaction(SIGALRM, &sa, 0);
+	setitimer(ITIMER_REAL, &tick, 0);
+}
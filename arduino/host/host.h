@@ -0,0 +1,77 @@
+/*
+  host.h - driving the virtual ATmega328P from a host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef Host_h
+#define Host_h
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// a pin that isn't driven: it reads as its pull-up, or 0 without one
+#define HOST_FLOATING 2
+// the level reported for a pin that has become an input
+#define HOST_INPUT 2
+
+// Called with the register's address, its value and whether the sketch
+// wrote it.  For a read, the value is what the built-in peripheral would
+// return and the result is what the sketch sees; for a write, it's what
+// was written and the result is what the register keeps.  A hook runs
+// in a signal handler, so it must use hostRead() and hostWrite() rather
+// than the register names.
+typedef uint8_t (*host_hook)(uint16_t addr, uint8_t value, uint8_t write);
+
+host_hook hostHook(uint16_t addr, host_hook fn);
+uint8_t hostRead(uint16_t addr);
+void hostWrite(uint16_t addr, uint8_t value);
+
+void hostPinInput(uint8_t pin, uint8_t level);
+uint8_t hostPinLevel(uint8_t pin);
+void hostOnPin(void (*fn)(uint8_t pin, uint8_t level));
+
+void hostAnalogInput(uint8_t channel, unsigned int value);
+void hostOnAnalog(unsigned int (*fn)(uint8_t channel));
+
+void hostSerialInput(const void *data, unsigned int n);
+void hostOnSerial(void (*fn)(uint8_t c));
+
+void hostOnSpi(uint8_t (*fn)(uint8_t c));
+
+// hostOnTwi() events
+#define HOST_TWI_ADDRESS 0
+#define HOST_TWI_WRITE 1
+#define HOST_TWI_READ 2
+#define HOST_TWI_STOP 3
+
+void hostOnTwi(uint8_t (*fn)(uint8_t event, uint8_t c));
+
+unsigned long long hostCycles(void);
+void hostExit(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
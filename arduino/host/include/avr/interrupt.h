@@ -0,0 +1,61 @@
+/*
+  avr/interrupt.h - interrupts for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+void hostSei(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// clearing I is all cli() does; sei() also lets anything pending in
+#define cli() do { *__host_sreg_rw &= (uint8_t) ~_BV(SREG_I); __asm__ __volatile__ ("" ::: "memory"); } while (0)
+#define sei() do { __asm__ __volatile__ ("" ::: "memory"); hostSei(); } while (0)
+
+// handlers are plain functions, found by host.c under their vector names;
+// the attributes (ISR_NAKED and the like) mean nothing here
+#ifdef __cplusplus
+#define ISR(vector, ...) extern "C" void vector(void); void vector(void)
+#else
+#define ISR(vector, ...) void vector(void); void vector(void)
+#endif
+#define SIGNAL(vector) ISR(vector)
+#define EMPTY_INTERRUPT(vector) ISR(vector) { }
+#define ISR_ALIAS(vector, target) ISR(vector) { target(); }
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define ISR_ALIASOF(target)
+
+#define reti() return
+
+#endif
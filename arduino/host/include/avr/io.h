@@ -0,0 +1,96 @@
+/*
+  avr/io.h - registers for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// The registers live in __host_io, at their data space addresses; host.c
+// keeps it unreadable so that every access traps into the peripherals it
+// models.  SREG has a page of its own that can be read but not written,
+// so reading it is free and restoring it lets in whatever interrupt is
+// pending, as on the chip; cli() goes through __host_sreg_rw instead.
+extern volatile uint8_t __host_io[];
+extern volatile uint8_t __host_sreg[];
+extern volatile uint8_t *__host_sreg_rw;
+
+// A stand-in for the data space, for wiring_memory.c: SP and the heap,
+// from HOST_HEAP_START up to __brkval, are offsets into it, which a test
+// moves about as a sketch's stack and malloc() would.
+extern uint8_t __host_ram[];
+#define HOST_HEAP_START 0x300
+
+#ifdef __cplusplus
+}
+#endif
+
+// pins_arduino.c is built with HOST_IO_OFFSETS, so that its tables get
+// constant offsets into __host_io instead of addresses
+#if defined(HOST_IO_OFFSETS)
+#define _HOST_IO ((volatile uint8_t *) 0)
+#else
+#define _HOST_IO __host_io
+#endif
+
+#define _SFR_MEM8(a) (*(volatile uint8_t *) (_HOST_IO + (a)))
+#define _SFR_MEM16(a) (*(volatile uint16_t *) (_HOST_IO + (a)))
+#define _SFR_IO8(a) _SFR_MEM8((a) + 0x20)
+#define _SFR_IO16(a) _SFR_MEM16((a) + 0x20)
+#define _SFR_MEM_ADDR(sfr) ((uint16_t) ((volatile uint8_t *) &(sfr) - _HOST_IO))
+#define _SFR_IO_ADDR(sfr) (_SFR_MEM_ADDR(sfr) - 0x20)
+#define _SFR_BYTE(sfr) (sfr)
+#define _SFR_WORD(sfr) (sfr)
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) (_SFR_BYTE(sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!(_SFR_BYTE(sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+#define _VECTOR(n) __vector_ ## n
+
+#define SREG (__host_sreg[0])
+#define SPL _SFR_MEM8(0x5D)
+#define SPH _SFR_MEM8(0x5E)
+#define SP _SFR_MEM16(0x5D)
+#define SREG_C 0
+#define SREG_Z 1
+#define SREG_N 2
+#define SREG_V 3
+#define SREG_S 4
+#define SREG_H 5
+#define SREG_T 6
+#define SREG_I 7
+
+#if defined(__AVR_ATmega328P__)
+#include <avr/iom328p.h>
+#else
+#error "the host build only models the ATmega328P"
+#endif
+
+#endif
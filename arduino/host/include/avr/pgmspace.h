@@ -0,0 +1,72 @@
+/*
+  avr/pgmspace.h - program memory for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef __PGMSPACE_H_
+#define __PGMSPACE_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+// there's only the one address space off the avr
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+#define PGM_VOID_P const void *
+
+typedef void prog_void;
+typedef char prog_char;
+typedef unsigned char prog_uchar;
+typedef int8_t prog_int8_t;
+typedef uint8_t prog_uint8_t;
+typedef int16_t prog_int16_t;
+typedef uint16_t prog_uint16_t;
+typedef int32_t prog_int32_t;
+typedef uint32_t prog_uint32_t;
+
+#define pgm_read_byte(a) (*(const uint8_t *) (a))
+#define pgm_read_word(a) (*(const uint16_t *) (a))
+#define pgm_read_dword(a) (*(const uint32_t *) (a))
+#define pgm_read_float(a) (*(const float *) (a))
+#define pgm_read_ptr(a) (*(void * const *) (a))
+#define pgm_read_byte_near(a) pgm_read_byte(a)
+#define pgm_read_word_near(a) pgm_read_word(a)
+#define pgm_read_dword_near(a) pgm_read_dword(a)
+#define pgm_read_byte_far(a) pgm_read_byte(a)
+#define pgm_read_word_far(a) pgm_read_word(a)
+
+#define memcmp_P memcmp
+#define memcpy_P memcpy
+#define strcat_P strcat
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+#define strncpy_P strncpy
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+#define printf_P printf
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  stdlib.h - the avr-libc additions to stdlib.h, for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#include_next <stdlib.h>
+
+#ifndef _HOST_STDLIB_H_
+#define _HOST_STDLIB_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+char *itoa(int value, char *s, int radix);
+char *ltoa(long value, char *s, int radix);
+char *utoa(unsigned int value, char *s, int radix);
+char *ultoa(unsigned long value, char *s, int radix);
+char *dtostrf(double value, signed char width, unsigned char prec, char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/*
+  util/delay.h - busy waits for the host build
+  Part of Arduino - http://www.arduino.cc/
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+
+  $Id$
+*/
+
+
+#ifndef _UTIL_DELAY_H_
+#define _UTIL_DELAY_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// spin on the virtual clock, with interrupts carrying on as usual
+void _delay_us(double us);
+void _delay_ms(double ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
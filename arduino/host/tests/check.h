@@ -0,0 +1,17 @@
+// The host tests: each is a sketch that exits 0 once it's seen what it
+// wanted, or 1 at the first CHECK() that fails.  See "make check".
+
+#ifndef Check_h
+#define Check_h
+
+#include <stdio.h>
+#include "host.h"
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+		hostExit(1); \
+	} \
+} while (0)
+
+#endif
@@ -0,0 +1,32 @@
+// delay() and delayMicroseconds() wait as long as they're asked to, and
+// not much longer, going by millis() and micros().
+
+#include <WProgram.h>
+#include "check.h"
+
+void setup()
+{
+}
+
+void loop()
+{
+	static const unsigned int ms[] = { 1, 10, 100, 250 };
+	unsigned long start, took;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(ms) / sizeof(ms[0]); i++) {
+		start = micros();
+		delay(ms[i]);
+		took = micros() - start;
+		CHECK(took >= 1000UL * ms[i]);
+		// the host runs on wall time, and can lose the cpu now and then
+		CHECK(took < 1000UL * ms[i] + 10000);
+	}
+
+	start = micros();
+	delayMicroseconds(500);
+	took = micros() - start;
+	CHECK(took >= 490);
+
+	hostExit(0);
+}
@@ -0,0 +1,60 @@
+// A handler bound at compile time with EXTERNAL_INTERRUPT_HANDLER() on
+// one interrupt links and runs alongside attachInterrupt() and edge
+// capture on the other.
+
+#include <WProgram.h>
+#include "check.h"
+
+static volatile unsigned int bound, attached;
+
+EXTERNAL_INTERRUPT_HANDLER(1)
+{
+	bound++;
+}
+
+static void onInt0()
+{
+	attached++;
+}
+
+static void pulses(uint8_t pin, int n)
+{
+	while (n--) {
+		hostPinInput(pin, 1);
+		hostPinInput(pin, 0);
+	}
+}
+
+void setup()
+{
+	edge_event e;
+
+	pinMode(2, INPUT);
+	pinMode(3, INPUT);
+	hostPinInput(2, 0);
+	hostPinInput(3, 0);
+
+	enableExternalInterrupt(1, RISING);
+	attachInterrupt(0, onInt0, FALLING);
+	pulses(2, 4);
+	pulses(3, 6);
+	CHECK(attached == 4);
+	CHECK(bound == 6);
+
+	detachInterrupt(0);
+	CHECK(edgeCaptureBegin(0, CHANGE));
+	pulses(2, 3);
+	pulses(3, 1);
+	CHECK(edgeAvailable() == 6);
+	CHECK(edgeRead(&e) && e.interrupt == 0 && e.level == HIGH);
+	CHECK(edgeRead(&e) && e.interrupt == 0 && e.level == LOW);
+	CHECK(attached == 4);
+	CHECK(bound == 7);
+	edgeCaptureEnd(0);
+
+	hostExit(0);
+}
+
+void loop()
+{
+}
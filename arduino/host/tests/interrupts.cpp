@@ -0,0 +1,58 @@
+// attachInterrupt() sees each edge it asked for and no others, and
+// nothing once detached.
+
+#include <WProgram.h>
+#include "check.h"
+
+static volatile unsigned int hits0, hits1;
+
+static void onInt0()
+{
+	hits0++;
+}
+
+static void onInt1()
+{
+	hits1++;
+}
+
+static void pulses(uint8_t pin, int n)
+{
+	while (n--) {
+		hostPinInput(pin, 1);
+		hostPinInput(pin, 0);
+	}
+}
+
+void setup()
+{
+	pinMode(2, INPUT);
+	pinMode(3, INPUT);
+	hostPinInput(2, 0);
+	hostPinInput(3, 0);
+}
+
+void loop()
+{
+	attachInterrupt(0, onInt0, RISING);
+	attachInterrupt(1, onInt1, FALLING);
+	pulses(2, 10);
+	pulses(3, 7);
+	CHECK(hits0 == 10);
+	CHECK(hits1 == 7);
+
+	hits0 = hits1 = 0;
+	attachInterrupt(0, onInt0, CHANGE);
+	pulses(2, 5);
+	CHECK(hits0 == 10);
+	CHECK(hits1 == 0);
+
+	hits0 = 0;
+	detachInterrupt(0);
+	detachInterrupt(1);
+	pulses(2, 5);
+	pulses(3, 5);
+	CHECK(hits0 == 0 && hits1 == 0);
+
+	hostExit(0);
+}
@@ -0,0 +1,71 @@
+// The memory watch, on a stand-in data space: a big block from malloc()
+// after memoryWatch() doesn't trip it, a stack that comes too close
+// does, and so does one that went too deep and came back in between.
+
+#include <WProgram.h>
+#include <string.h>
+#include "wiring_memory.h"
+#include "check.h"
+
+extern "C" void memoryPaint(void);
+extern "C" void memoryWatchRun(void);
+extern "C" char *__brkval;
+
+static volatile uint8_t tripped;
+
+static void trip()
+{
+	tripped++;
+}
+
+static char *ram(unsigned int a)
+{
+	return (char *) __host_ram + a;
+}
+
+void setup()
+{
+	unsigned int sp = RAMEND - 0x40;
+
+	SP = sp;
+	memoryPaint();
+	CHECK(freeMemory() == (int) (sp - HOST_HEAP_START));
+
+	CHECK(memoryWatch(trip));
+	delay(5);
+	CHECK(!tripped);
+
+	// a 100 byte String, say, with the heap's top noted before it
+	__brkval = ram(HOST_HEAP_START + 100);
+	memset(ram(HOST_HEAP_START), 'x', 100);
+	delay(5);
+	CHECK(!tripped);
+
+	// a call chain down to MEMORY_GUARD / 2 bytes above the old top of
+	// the heap, and back, between two checks; still clear of the block
+	memoryWatchRun();
+	memset(ram(HOST_HEAP_START + 100 + MEMORY_GUARD * 2), 0x42, sp - HOST_HEAP_START - 100 - MEMORY_GUARD * 2);
+	delay(5);
+	CHECK(!tripped);
+	memset(ram(HOST_HEAP_START + 100 + MEMORY_GUARD / 2), 0x42, MEMORY_GUARD * 3 / 2);
+	delay(5);
+	CHECK(tripped == 1);
+	memoryWatchEnd();
+
+	// the stack itself too close
+	tripped = 0;
+	memoryPaint();
+	SP = HOST_HEAP_START + 100 + MEMORY_GUARD * 2;
+	CHECK(memoryWatch(trip));
+	delay(5);
+	CHECK(!tripped);
+	SP = HOST_HEAP_START + 100 + MEMORY_GUARD - 1;
+	delay(5);
+	CHECK(tripped == 1);
+
+	hostExit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,29 @@
+// micros() never goes backwards, across timer 0 overflows included, and
+// agrees with millis().
+
+#include <WProgram.h>
+#include "check.h"
+
+void setup()
+{
+}
+
+void loop()
+{
+	unsigned long last = micros(), now, ms;
+	long n;
+
+	for (n = 0; n < 200000; n++) {
+		now = micros();
+		CHECK((long) (now - last) >= 0);
+		last = now;
+	}
+
+	ms = millis();
+	now = micros();
+	CHECK(now / 1000 - ms <= 2);
+	// it got past a good few overflows
+	CHECK(ms > 10);
+
+	hostExit(0);
+}
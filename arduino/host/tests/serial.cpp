@@ -0,0 +1,47 @@
+// What Serial sends comes back to it through the receive side, in order
+// and intact, at a few baud rates.
+
+#include <WProgram.h>
+#include <string.h>
+#include "check.h"
+
+static void loopBack(uint8_t c)
+{
+	hostSerialInput(&c, 1);
+}
+
+static void roundTrip(long baud)
+{
+	static const char text[] = "The quick brown fox jumps over the lazy dog 0123456789\n";
+	char got[sizeof(text)];
+	unsigned int n = 0;
+	unsigned long start;
+
+	Serial.begin(baud);
+	Serial.print(text);
+
+	start = millis();
+	while (n < sizeof(text) - 1 && millis() - start < 1000)
+		if (Serial.available())
+			got[n++] = Serial.read();
+	got[n] = 0;
+
+	CHECK(strcmp(got, text) == 0);
+	CHECK(Serial.available() == 0);
+	CHECK(Serial.read() == -1);
+	Serial.end();
+}
+
+void setup()
+{
+	hostOnSerial(loopBack);
+}
+
+void loop()
+{
+	roundTrip(9600);
+	roundTrip(57600);
+	roundTrip(115200);
+
+	hostExit(0);
+}
@@ -0,0 +1,101 @@
+// Queued SPI transactions go out whole and in the order they were queued,
+// each with its own chip select, and one queued from a callback goes to
+// the back of the line.  A buffered shift on the SPI pins while the queue
+// has the bus is bit-banged rather than put on the wire between them.
+
+#include <WProgram.h>
+#include <string.h>
+#include "pins_arduino.h"
+#include "wiring_spi.h"
+#include "check.h"
+
+static spi_device dev[2];
+static spi_transaction t[4], late;
+static uint8_t tx[4][6], rx[4][6], lateTx[2] = { 0xA0, 0xA1 };
+static uint8_t wire[64];
+static volatile unsigned int sent;
+static volatile uint8_t order[8], done;
+
+// MISO echoes MOSI inverted; note which chip is selected for each byte
+static uint8_t bus(uint8_t c)
+{
+	uint8_t cs9 = !hostPinLevel(9), cs10 = !hostPinLevel(10);
+
+	CHECK(cs9 + cs10 == 1);
+	if (sent < sizeof(wire))
+		wire[sent++] = c;
+	return ~c;
+}
+
+static void finished(spi_transaction *x)
+{
+	order[done++] = x == &late ? 4 : x - t;
+	if (x == &t[1])
+		spiQueue(&late);
+}
+
+void setup()
+{
+	unsigned int i, j, k;
+
+	hostOnSpi(bus);
+	spiBegin();
+	spiDeviceInit(&dev[0], 9, SPI_MODE0, SPI_CLOCK_DIV4, MSBFIRST);
+	spiDeviceInit(&dev[1], 10, SPI_MODE0, SPI_CLOCK_DIV64, MSBFIRST);
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 6; j++)
+			tx[i][j] = i * 16 + j;
+		t[i].device = &dev[i & 1];
+		t[i].txBuffer = tx[i];
+		t[i].rxBuffer = rx[i];
+		t[i].length = 3 + i;
+		t[i].status = SPI_IDLE;
+		t[i].callback = finished;
+	}
+	late.device = &dev[0];
+	late.txBuffer = lateTx;
+	late.rxBuffer = 0;
+	late.length = 2;
+	late.status = SPI_IDLE;
+	late.callback = finished;
+
+	// an empty one is turned down rather than finished on the spot
+	late.length = 0;
+	CHECK(!spiQueue(&late));
+	CHECK(late.status == SPI_IDLE && done == 0);
+	late.length = 2;
+
+	for (i = 0; i < 4; i++)
+		CHECK(spiQueue(&t[i]));
+	CHECK(!spiQueue(&t[3]));
+
+	// bus() would see these with no chip selected if they went out
+	// through the SPI unit
+	shiftOutBuffer(MOSI, SCK, MSBFIRST, lateTx, sizeof(lateTx));
+	CHECK(spiBusy());
+
+	while (spiBusy())
+		;
+
+	CHECK(done == 5);
+	CHECK(order[0] == 0 && order[1] == 1 && order[2] == 2 && order[3] == 3 && order[4] == 4);
+
+	k = 0;
+	for (i = 0; i < 4; i++) {
+		CHECK(t[i].status == SPI_DONE);
+		for (j = 0; j < t[i].length; j++) {
+			CHECK(wire[k++] == tx[i][j]);
+			CHECK(rx[i][j] == (uint8_t) ~tx[i][j]);
+		}
+	}
+	CHECK(wire[k++] == 0xA0 && wire[k++] == 0xA1);
+	CHECK(sent == k);
+	CHECK(hostPinLevel(9) == 1 && hostPinLevel(10) == 1);
+
+	hostExit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,86 @@
+// A few hundred thousand String allocations, concatenations and copies,
+// after which the contents are right and every block has been freed.
+
+#include <WProgram.h>
+#include <stdlib.h>
+#include "check.h"
+
+// glibc's allocator under ours, so that the blocks in use can be counted
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static long blocks;
+
+extern "C" void *malloc(size_t n)
+{
+	void *p = __libc_malloc(n);
+
+	if (p)
+		blocks++;
+	return p;
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+	void *p = __libc_calloc(n, size);
+
+	if (p)
+		blocks++;
+	return p;
+}
+
+extern "C" void *realloc(void *p, size_t n)
+{
+	void *q = __libc_realloc(p, n);
+
+	if (!p && q)
+		blocks++;
+	else if (p && n == 0)
+		blocks--;
+	return q;
+}
+
+extern "C" void free(void *p)
+{
+	if (p)
+		blocks--;
+	__libc_free(p);
+}
+
+void setup()
+{
+	CHECK(String(255UL, HEX) == "ff");
+	CHECK(String(-42) == "-42");
+}
+
+void loop()
+{
+	long before = blocks;
+	unsigned long seed = 1;
+	long n;
+
+	for (n = 0; n < 100000; n++) {
+		String a("x");
+		String b;
+		unsigned int len = 1, i;
+
+		seed = seed * 1103515245 + 12345;
+		for (i = (seed >> 16) % 24; i > 0; i--) {
+			a += a.length() % 10;
+			len++;
+		}
+		b = a;
+		b += "-";
+		b += a;
+		CHECK(a.length() == len);
+		CHECK(b.length() == 2 * len + 1);
+		CHECK(b.startsWith(a) && b.endsWith(a));
+		CHECK(b.charAt(len) == '-');
+	}
+
+	CHECK(blocks == before);
+
+	hostExit(0);
+}
@@ -0,0 +1,160 @@
+// The TWI master against a small register device at 0x50: a write sets
+// the register pointer and fills registers, a read carries on from the
+// pointer, and a write then read turns round with a repeated start.
+// Nothing answers at 0x51, the device refuses writes past its last
+// register, an address probe goes out as a write, and twiRecover() clocks
+// a slave holding SDA low until it lets go.
+
+#include <WProgram.h>
+#include "pins_arduino.h"
+#include "wiring_twi.h"
+#include "check.h"
+
+#define DEVICE 0x50
+#define REGISTERS 8
+
+static uint8_t reg[REGISTERS], pointer, addressed;
+static uint8_t events[64], values[64];
+static volatile uint8_t seen, clocks;
+
+static void note(uint8_t event, uint8_t c)
+{
+	if (seen < sizeof(events)) {
+		events[seen] = event;
+		values[seen++] = c;
+	}
+}
+
+static uint8_t device(uint8_t event, uint8_t c)
+{
+	note(event, c);
+	switch (event) {
+	case HOST_TWI_ADDRESS:
+		addressed = 0;
+		return (c >> 1) == DEVICE;
+	case HOST_TWI_WRITE:
+		if (addressed++ == 0) {
+			pointer = c;
+			return 1;
+		}
+		if (pointer >= REGISTERS)
+			return 0;
+		reg[pointer++] = c;
+		return 1;
+	case HOST_TWI_READ:
+		return pointer < REGISTERS ? reg[pointer++] : 0xFF;
+	}
+	return 0;
+}
+
+// the stuck slave lets go of SDA after three clocks
+static void pin(uint8_t p, uint8_t level)
+{
+	if (p == SCL && level == 0 && ++clocks == 3)
+		hostPinInput(SDA, HOST_FLOATING);
+}
+
+static void expect(uint8_t i, uint8_t event, uint8_t c)
+{
+	CHECK(i < seen);
+	CHECK(events[i] == event);
+	CHECK(values[i] == c);
+}
+
+void setup()
+{
+	static const uint8_t fill[] = { 2, 0x11, 0x22, 0x33 };
+	static const uint8_t at2[] = { 2 };
+	static const uint8_t over[] = { 7, 0x77, 0x88, 0x99 };
+	static const uint8_t last[] = { 6, 0x66, 0x77, 0x88 };
+	static const uint8_t next[] = { 0, 0xAA };
+	uint8_t rx[4];
+	twi_transaction stuck, after;
+
+	hostOnTwi(device);
+	twiBegin(100000);
+
+	// write
+	CHECK(twiTransfer(DEVICE, fill, sizeof(fill), 0, 0) == TWI_DONE);
+	CHECK(reg[2] == 0x11 && reg[3] == 0x22 && reg[4] == 0x33);
+	CHECK(seen == 6);
+	expect(0, HOST_TWI_ADDRESS, DEVICE << 1);
+	expect(1, HOST_TWI_WRITE, 2);
+	expect(4, HOST_TWI_WRITE, 0x33);
+	expect(5, HOST_TWI_STOP, 0);
+
+	// write then read, with the master acknowledging all but the last
+	seen = 0;
+	CHECK(twiTransfer(DEVICE, at2, sizeof(at2), rx, 3) == TWI_DONE);
+	CHECK(rx[0] == 0x11 && rx[1] == 0x22 && rx[2] == 0x33);
+	CHECK(seen == 7);
+	expect(0, HOST_TWI_ADDRESS, DEVICE << 1);
+	expect(1, HOST_TWI_WRITE, 2);
+	expect(2, HOST_TWI_ADDRESS, (DEVICE << 1) | 1);
+	expect(3, HOST_TWI_READ, 1);
+	expect(4, HOST_TWI_READ, 1);
+	expect(5, HOST_TWI_READ, 0);
+	expect(6, HOST_TWI_STOP, 0);
+
+	// read, carrying on from the pointer
+	seen = 0;
+	reg[5] = 0x55;
+	CHECK(twiTransfer(DEVICE, 0, 0, rx, 1) == TWI_DONE);
+	CHECK(rx[0] == 0x55);
+	CHECK(seen == 3);
+	expect(0, HOST_TWI_ADDRESS, (DEVICE << 1) | 1);
+	expect(1, HOST_TWI_READ, 0);
+
+	// nobody home
+	seen = 0;
+	CHECK(twiTransfer(DEVICE + 1, fill, sizeof(fill), 0, 0) == TWI_NACK);
+	CHECK(twiTransfer(DEVICE + 1, 0, 0, rx, 1) == TWI_NACK);
+	CHECK(seen == 4);
+	expect(1, HOST_TWI_STOP, 0);
+
+	// a refused byte is an error unless it's the last one
+	CHECK(twiTransfer(DEVICE, over, sizeof(over), 0, 0) == TWI_NACK);
+	CHECK(reg[7] == 0x77);
+	CHECK(twiTransfer(DEVICE, last, sizeof(last), 0, 0) == TWI_DONE);
+	CHECK(reg[6] == 0x66 && reg[7] == 0x77);
+
+	// an address probe is a write of nothing
+	seen = 0;
+	CHECK(twiTransfer(DEVICE, 0, 0, 0, 0) == TWI_DONE);
+	CHECK(twiTransfer(DEVICE + 1, 0, 0, 0, 0) == TWI_NACK);
+	CHECK(seen == 4);
+	expect(0, HOST_TWI_ADDRESS, DEVICE << 1);
+	expect(2, HOST_TWI_ADDRESS, (DEVICE + 1) << 1);
+
+	// a slave holding SDA low keeps the start from going out until
+	// twiRecover() clocks it free; the queue then carries on
+	hostOnPin(pin);
+	hostPinInput(SDA, 0);
+	stuck.address = DEVICE;
+	stuck.txBuffer = fill;
+	stuck.txLength = sizeof(fill);
+	stuck.rxLength = 0;
+	stuck.status = TWI_IDLE;
+	stuck.callback = 0;
+	after = stuck;
+	after.txBuffer = next;
+	after.txLength = sizeof(next);
+	CHECK(twiQueue(&stuck) && twiQueue(&after));
+	delay(5);
+	CHECK(stuck.status == TWI_ACTIVE && after.status == TWI_QUEUED);
+
+	twiRecover();
+	CHECK(clocks == 3);
+	CHECK(hostPinLevel(SDA) == 1);
+	CHECK(stuck.status == TWI_BUS_ERROR);
+	while (twiBusy())
+		;
+	CHECK(after.status == TWI_DONE);
+	CHECK(reg[0] == 0xAA);
+
+	hostExit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# profile.py - pretty-prints the PROFILE_SCOPE() probes dumped by
+# profileDump(), in either format, from a serial port or a file.
+#
+#   profile.py -p /dev/ttyACM0 -b 115200     first dump from the board
+#   profile.py -p /dev/ttyACM0 -f            every dump as it comes
+#   profile.py capture.bin                   a dump saved earlier
+#
+# Reading a serial port needs pyserial.  Anything around the dumps, such
+# as the sketch's own output, is skipped.
+#
+# This file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation; either version 2.1 of the License, or
+# (at your option) any later version.
+
+import argparse
+import struct
+import sys
+
+
+class Source:
+    """Bytes from a serial port or a file, one at a time."""
+
+    def __init__(self, args):
+        if args.port:
+            import serial
+            self.f = serial.Serial(args.port, args.baud)
+        elif args.file and args.file != "-":
+            self.f = open(args.file, "rb")
+        else:
+            self.f = sys.stdin.buffer
+
+    def byte(self):
+        b = self.f.read(1)
+        if not b:
+            raise EOFError
+        return b[0]
+
+    def bytes(self, n):
+        return bytes(self.byte() for _ in range(n))
+
+    def line(self):
+        s = bytearray()
+        while True:
+            b = self.byte()
+            if b == 0x0A:
+                return s.decode("ascii", "replace").strip()
+            s.append(b)
+
+
+def read_binary(src):
+    n = src.byte()
+    body = bytearray([n])
+    head = src.bytes(8)
+    body += head
+    f_cpu, overhead = struct.unpack("<II", head)
+    probes = []
+    for _ in range(n):
+        length = src.byte()
+        name = src.bytes(length)
+        numbers = src.bytes(16)
+        body += bytes([length]) + name + numbers
+        probes.append((name.decode("ascii", "replace"),) + struct.unpack("<IIII", numbers))
+    if src.byte() != sum(body) & 0xFF:
+        raise ValueError("checksum mismatch")
+    return f_cpu, overhead, probes
+
+
+def read_text(src, first):
+    f_cpu, overhead = (int(x) for x in first.split()[1:3])
+    probes = []
+    while True:
+        line = src.line()
+        if line == "end":
+            return f_cpu, overhead, probes
+        # names may contain spaces; the four numbers are the last fields
+        fields = line.rsplit(None, 4)
+        probes.append((fields[0],) + tuple(int(x) for x in fields[1:]))
+
+
+def read_dump(src):
+    """Skips to the next dump and reads it."""
+    prev = None
+    text = bytearray()
+    while True:
+        b = src.byte()
+        if prev == 0xA5 and b == ord("P"):
+            try:
+                return read_binary(src)
+            except ValueError as e:
+                print("profile.py: %s, skipping a dump" % e, file=sys.stderr)
+        prev = b
+        if b == 0x0A:
+            line = text.decode("ascii", "replace").strip()
+            text = bytearray()
+            if line.startswith("profile "):
+                return read_text(src, line)
+        else:
+            text.append(b)
+
+
+def show(f_cpu, overhead, probes):
+    mhz = f_cpu / 1e6
+    grand = sum(p[2] for p in probes) or 1
+    print("%d probes, %.3g MHz, %d cycles taken off each reading for the probe"
+          % (len(probes), mhz, overhead))
+    print("%-20s %10s %12s %6s %10s %10s %10s %10s"
+          % ("probe", "count", "total", "%", "mean", "mean us", "min", "max"))
+    for name, count, total, lo, hi in sorted(probes, key=lambda p: -p[2]):
+        mean = total / count if count else 0
+        print("%-20s %10d %12d %6.1f %10.1f %10.2f %10d %10d"
+              % (name, count, total, 100.0 * total / grand, mean, mean / mhz, lo, hi))
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Pretty-prints profileDump() output.")
+    ap.add_argument("file", nargs="?", help="a saved dump, or - for stdin")
+    ap.add_argument("-p", "--port", help="serial port to read from")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("-f", "--follow", action="store_true",
+                    help="keep showing dumps as they arrive")
+    args = ap.parse_args()
+
+    src = Source(args)
+    try:
+        while True:
+            show(*read_dump(src))
+            if not args.follow:
+                break
+    except EOFError:
+        pass
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#
+# sampler.py - turns a samplerDump() histogram into a flat profile by
+# function, using the symbol table that "make build-cli/<sketch>.sym"
+# writes with avr-nm -n.
+#
+#   sampler.py -s build-cli/Blink.sym -p /dev/ttyACM0     from the board
+#   sampler.py -s build-cli/Blink.sym capture.txt         a saved dump
+#
+# A bin that covers parts of several functions has its samples shared
+# between them by the bytes of each inside it, so with wide bins the
+# profile is an estimate; narrow the range given to samplerBegin() for a
+# sharper one.  Reading a serial port needs pyserial.
+#
+# This file is free software; you can redistribute it and/or modify it
+# under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation; either version 2.1 of the License, or
+# (at your option) any later version.
+
+import argparse
+import sys
+
+
+def read_symbols(path):
+    """(address, name) for the code symbols in an nm -n listing, sorted."""
+    syms = []
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in "TtWw":
+                continue
+            addr = int(fields[0], 16)
+            # data lives at 0x800000 and up in the avr address space
+            if addr >= 0x800000:
+                continue
+            syms.append((addr, fields[2]))
+    syms.sort()
+    return syms
+
+
+def lines(args):
+    if args.port:
+        import serial
+        port = serial.Serial(args.port, args.baud)
+        while True:
+            yield port.readline().decode("ascii", "replace").strip()
+    f = open(args.file) if args.file and args.file != "-" else sys.stdin
+    for line in f:
+        yield line.strip()
+
+
+def read_dump(it):
+    """Skips to the next dump and reads it."""
+    for line in it:
+        if line.startswith("sampler "):
+            rate, base, size, bins, outside = (int(x) for x in line.split()[1:6])
+            counts = {}
+            for line in it:
+                if line == "end":
+                    return rate, base, size, bins, outside, counts
+                b, n = line.split()
+                counts[int(b)] = int(n)
+    raise EOFError
+
+
+def attribute(syms, base, size, counts):
+    """Samples per function, sharing each bin by overlap."""
+    result = {}
+    for b, n in counts.items():
+        lo = base + b * size
+        hi = lo + size
+        shares = []
+        for i, (addr, name) in enumerate(syms):
+            end = syms[i + 1][0] if i + 1 < len(syms) else hi
+            overlap = min(hi, end) - max(lo, addr)
+            if overlap > 0:
+                shares.append((name, overlap))
+        total = sum(o for _, o in shares)
+        if total == 0:
+            shares, total = [("0x%x" % lo, 1)], 1
+        for name, o in shares:
+            result[name] = result.get(name, 0.0) + n * o / total
+    return result
+
+
+def show(syms, dump, show_bins):
+    rate, base, size, bins, outside, counts = dump
+    inside = sum(counts.values())
+    total = (inside + outside) or 1
+    print("%d samples at %d/s, %d bins of %d bytes from 0x%x, %d outside"
+          % (inside + outside, rate, bins, size, base, outside))
+    print("%-36s %10s %7s %10s" % ("function", "samples", "%", "seconds"))
+    funcs = attribute(syms, base, size, counts)
+    for name, n in sorted(funcs.items(), key=lambda f: -f[1]):
+        print("%-36s %10.1f %7.2f %10.3f" % (name, n, 100.0 * n / total, n / rate))
+    if outside:
+        print("%-36s %10d %7.2f %10.3f"
+              % ("(outside the range)", outside, 100.0 * outside / total, outside / rate))
+    if show_bins:
+        print()
+        print("%-10s %-10s %10s" % ("from", "to", "samples"))
+        for b in sorted(counts):
+            lo = base + b * size
+            print("0x%-8x 0x%-8x %10d" % (lo, lo + size, counts[b]))
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Flat profile from samplerDump() output.")
+    ap.add_argument("file", nargs="?", help="a saved dump, or - for stdin")
+    ap.add_argument("-s", "--sym", required=True, help="the sketch's .sym file")
+    ap.add_argument("-p", "--port", help="serial port to read from")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("--bins", action="store_true", help="list the bins too")
+    ap.add_argument("-f", "--follow", action="store_true",
+                    help="keep showing dumps as they arrive")
+    args = ap.parse_args()
+
+    syms = read_symbols(args.sym)
+    it = lines(args)
+    try:
+        while True:
+            show(syms, read_dump(it), args.bins)
+            if not args.follow:
+                break
+    except EOFError:
+        pass
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()